@@ -6,6 +6,11 @@
 #include <AMReX_PlotFileUtil.H>
 #include <nodal_data_ops.H>
 #include <mpm_eb.H>
+#include <mpm_probes.H>
+#include <mpm_diagnostics_writer.H>
+#include <mpm_vtk.H>
+#include <mpm_levelset_bodies.H>
+#include <mpm_inflow.H>
 
 using namespace amrex;
 
@@ -49,6 +54,32 @@ void PrintMessage(std::string msg,int print_length,bool begin,char c)
 
 
 
+void WriteParticleAndGridFiles(MPMspecs &specs, MPMParticleContainer &mpm_pc, NodalData &nodal,
+                               Vector<std::string> &nodaldata_names, Vector<int> &nodaldata_comps,
+                               Geometry &geom, BoxArray &ba, DistributionMapping &dm,
+                               std::string particle_output_folder, std::string grid_output_folder,
+                               mpm_vtk::PVDCollection &particle_pvd, mpm_vtk::PVDCollection &grid_pvd,
+                               int fileindex, Real time)
+{
+	std::string pltfile = amrex::Concatenate(specs.prefix_gridfilename,fileindex,specs.num_of_digits_in_filenames);
+
+	if(specs.output_format!="vtk")
+	{
+		mpm_pc.writeParticles(particle_output_folder+specs.prefix_particlefilename,
+		                      specs.num_of_digits_in_filenames,fileindex,specs.particle_output_fields);
+		write_grid_file(grid_output_folder+pltfile,nodal,nodaldata_names,nodaldata_comps,
+		                geom,ba,dm,time,specs.nodal_output_coarsen_ratio);
+	}
+	if(specs.output_format!="plotfile")
+	{
+		particle_pvd.add(time,mpm_pc.writeParticlesVTK(particle_output_folder,specs.prefix_particlefilename,
+		                                               specs.num_of_digits_in_filenames,fileindex,
+		                                               specs.particle_output_fields));
+		grid_pvd.add(time,write_grid_file_vtk(grid_output_folder,pltfile,nodal,nodaldata_names,
+		                                      nodaldata_comps,geom,specs.nodal_output_coarsen_ratio));
+	}
+}
+
 int main (int argc, char* argv[])
 {
     amrex::Initialize(argc,argv);
@@ -144,8 +175,15 @@ int main (int argc, char* argv[])
             ng_cells = 2;
         }
 
+        //multi-field contact also builds the per-body state of the gather
+        //ghost nodes, which needs the particles around them
+        if(specs.multifield_contact)
+        {
+            ng_cells += (specs.order_scheme==3)?2:1;
+        }
+
         //Initialising EB class
-        mpm_ebtools::init_eb(geom,ba,dm);												
+        mpm_ebtools::init_eb(geom,ba,dm,specs.redistribution_drift_cells(),(specs.order_scheme==3)?2:1);												
         MPMParticleContainer mpm_pc(geom, dm, ba, ng_cells);							
 
         //Initialising particle object
@@ -171,14 +209,6 @@ int main (int argc, char* argv[])
                                  specs.no_of_rigidbodies_present,
                                  specs.ifrigidnodespresent);
             PrintMessage(msg,print_length,false);
-
-            if(specs.no_of_rigidbodies_present!=numrigidbodies)
-            {
-                amrex::Print()<<"\n specs.no_of_rigidbodies_present= "
-                <<specs.no_of_rigidbodies_present<<" "<<numrigidbodies;
-                //amrex::Abort("\n Sorry! The number of rigid bodies defined in 
-                //particles file and in constants.H file do not match. Aborting..");
-            }
         }
         else
         {
@@ -192,6 +222,10 @@ int main (int argc, char* argv[])
             PrintMessage(msg,print_length,false);
         }
 
+        //the particle file is read on one rank and restarts do not carry the
+        //count, so the number of rigid bodies is taken from the particles
+        specs.no_of_rigidbodies_present=mpm_pc.Calculate_Number_of_RigidBodies();
+        specs.ifrigidnodespresent=(specs.no_of_rigidbodies_present>0)?1:0;
         if(specs.ifrigidnodespresent==0)
         {
             amrex::Print()<<"\n No rigid bodies present";
@@ -203,20 +237,45 @@ int main (int argc, char* argv[])
             mpm_pc.removeParticlesInsideEB();
         }
 
+        //restarts keep the body of each particle from the checkpoint
+        if(specs.multifield_contact && specs.restart_checkfile=="")
+        {
+            mpm_pc.assign_contact_fields(specs.contact_field_boxes);
+        }
+        mpm_pc.set_sink_regions(specs.sink_regions);
+        //models are fixed per particle, so the delta strain form is checked
+        //once here and again only when particles are created
+        if(specs.calculate_strain_based_on_delta)
+        {
+            mpm_pc.check_delta_form_support();
+        }
+
         //Setting up rigid particle setups
         if(specs.no_of_rigidbodies_present > 0)
         {
-            specs.Rb = new Rigid_Bodies[specs.no_of_rigidbodies_present];
-            Array<int,numrigidbodies> position_update_method;
-            Array<int,numrigidbodies> enable_weight;
-            Array<int,numrigidbodies> enable_damping_force;
-            Array<Real,numrigidbodies> Damping_Coefficient;
+            const int nbodies=specs.no_of_rigidbodies_present;
+            specs.Rb.resize(nbodies);
+            Vector<int> position_update_method;
+            Vector<int> enable_weight;
+            Vector<int> enable_damping_force;
+            Vector<Real> Damping_Coefficient;
 
             ParmParse pp("mpm");
-            pp.get("position_update_method",position_update_method);
-            pp.get("enable_weight",enable_weight);
-            pp.get("enable_damping_force",enable_damping_force);
-            pp.get("Damping_Coefficient",Damping_Coefficient);
+            pp.getarr("position_update_method",position_update_method);
+            pp.getarr("enable_weight",enable_weight);
+            pp.getarr("enable_damping_force",enable_damping_force);
+            pp.getarr("Damping_Coefficient",Damping_Coefficient);
+            if(position_update_method.size()<nbodies || enable_weight.size()<nbodies ||
+               enable_damping_force.size()<nbodies || Damping_Coefficient.size()<nbodies)
+            {
+                amrex::Abort("\nmpm.position_update_method, enable_weight, enable_damping_force and "
+                             "Damping_Coefficient need one entry per rigid body ("+std::to_string(nbodies)+")");
+            }
+            //imposed motion for position_update_method=0, AMREX_SPACEDIM entries per body
+            Vector<Real> imposed_velocity(AMREX_SPACEDIM*nbodies,0.0);
+            Vector<Real> imposed_angular_velocity(AMREX_SPACEDIM*nbodies,0.0);
+            pp.queryarr("rigid_imposed_velocity",imposed_velocity,0,AMREX_SPACEDIM*nbodies);
+            pp.queryarr("rigid_imposed_angular_velocity",imposed_angular_velocity,0,AMREX_SPACEDIM*nbodies);
 
             for(int i=0;i<specs.no_of_rigidbodies_present;i++)
             {
@@ -230,13 +289,19 @@ int main (int argc, char* argv[])
                 specs.Rb[i].Damping_Coefficient=Damping_Coefficient[i];
                 specs.Rb[i].force_external={0.0,0.0,0.0};
                 specs.Rb[i].force_internal={0.0,0.0,0.0};
+                specs.Rb[i].force_contact={0.0,0.0,0.0};
+                specs.Rb[i].torque_contact={0.0,0.0,0.0};
                 specs.Rb[i].velocity={0.0,0.0,0.0};
-                specs.Rb[i].imposed_velocity={0.0,0.0,0.0};
+                specs.Rb[i].angular_velocity={0.0,0.0,0.0};
+                for(int k=0;k<AMREX_SPACEDIM;k++)
+                {
+                    specs.Rb[i].imposed_velocity[k]=imposed_velocity[AMREX_SPACEDIM*i+k];
+                    specs.Rb[i].imposed_angular_velocity[k]=imposed_angular_velocity[AMREX_SPACEDIM*i+k];
+                }
             }
-            mpm_pc.Calculate_Total_Mass_RigidParticles(0,specs.Rb[0].total_mass);
-            mpm_pc.Calculate_Total_Mass_RigidParticles(1,specs.Rb[1].total_mass);
-            mpm_pc.Calculate_Total_Number_of_rigid_particles(0,specs.Rb[0].num_of_mp);
-            mpm_pc.Calculate_Total_Number_of_rigid_particles(1,specs.Rb[1].num_of_mp);
+
+            //mass properties; the body frame is the world frame at this point
+            mpm_pc.Calculate_RigidBody_Totals(specs.Rb);
         }
 
 
@@ -246,15 +311,8 @@ int main (int argc, char* argv[])
         PrintMessage(msg,print_length,true);
         const BoxArray& nodeba = amrex::convert(ba, IntVect{1,1,1});
 
-        int ng_cells_nodaldata=1;
-        if(specs.order_scheme==1)
-        {
-            ng_cells_nodaldata=1;
-        }
-        else if(specs.order_scheme==3)
+        if(specs.order_scheme==3)
         {
-            ng_cells_nodaldata=3;
-
             specs.order_scheme_directional[XDIR] = ((specs.periodic[XDIR]==0)?
                                                     ((specs.ncells[XDIR]<5)?1:3):((specs.ncells[XDIR]<3)?1:3));
             specs.order_scheme_directional[YDIR] = ((specs.periodic[YDIR]==0)?
@@ -287,15 +345,29 @@ int main (int argc, char* argv[])
                 }
             }
         }
-        else
+        else if(specs.order_scheme!=1)
         {
             amrex::Abort("Order scheme not implemented yet");
            // Please use order_scheme=1 
            //              or order_scheme=3 in the input file \n");
         }
 
-        MultiFab nodaldata(nodeba, dm, NUM_STATES, ng_cells_nodaldata);
-        nodaldata.setVal(0.0,ng_cells_nodaldata);
+        //sized for the widest gather, from particles that moved for up to
+        //num_redist steps since the last redistribution
+        const int drift_cells=specs.redistribution_drift_cells();
+        IntVect ng_cells_nodaldata=nodal_gather_ghosts(specs.order_scheme_directional,drift_cells);
+        mpm_pc.set_gather_drift(drift_cells);
+        mpm_pc.set_multifield_contact(specs.multifield_contact);
+        //rigid-body and stress fields only exist when the run uses them
+        int nodal_stress_needed=(specs.test_number==7 || specs.test_number==8);
+        NodalData nodal;
+        nodal.define(nodeba,dm,ng_cells_nodaldata,specs.ifrigidnodespresent,nodal_stress_needed);
+
+        //rigid-body motion (RIGID_MOTION_COMPS per body) and contact loads
+        Vector<Real> rigid_motion_h;
+        Gpu::DeviceVector<Real> rigid_motion(RIGID_MOTION_COMPS*specs.no_of_rigidbodies_present);
+        Vector<Real> rigid_load;
+        MultiFab& nodaldata=nodal.core;
 
         MultiFab phasefield_data;
         BoxArray phase_ba=ba;
@@ -321,6 +393,9 @@ int main (int argc, char* argv[])
         PrintMessage(msg,print_length,true);
         dt 	= (specs.fixed_timestep==1)?specs.timestep:
         mpm_pc.Calculate_time_step(specs.CFL,specs.dt_max_limit,specs.dt_min_limit);
+        //single level until the first coarse step bins the particles
+        mpm_pc.assign_multirate_levels(specs.CFL,dt,1);
+        mpm_pc.build_eos_table(specs.eos_table_size,specs.eos_table_jmin,specs.eos_table_jmax);
         PrintMessage(msg,print_length,false);
 
         msg="\n Calculating initial strainrates and stresses";
@@ -349,9 +424,10 @@ int main (int argc, char* argv[])
 
         msg="\n Updating phase field";
         PrintMessage(msg,print_length,true);
-        if(specs.phasefield_output)
+        if(specs.phasefield_output && specs.phasefield_every_step)
         {
-            mpm_pc.update_phase_field(phasefield_data,specs.phasefield_gridratio,specs.phasefield_smoothfactor);
+            mpm_pc.update_phase_field(phasefield_data,specs.phasefield_gridratio,
+                                      specs.phasefield_smoothfactor,specs.phasefield_kernel);
         }
         PrintMessage(msg,print_length,false);
 
@@ -359,6 +435,10 @@ int main (int argc, char* argv[])
         msg="\n Initialising diagnostics";
         PrintMessage(msg,print_length,true);
 
+        //Diagnostics are buffered and written in chunks instead of every step
+        DiagnosticsWriter diagnostics;
+        diagnostics.read_specs("diagnostics",specs.restart_checkfile!="","./","ascii");
+
         if(specs.print_diagnostics)
         {
             Real TKE=0.0;
@@ -381,37 +461,36 @@ int main (int argc, char* argv[])
                         Vmex = mpm_pc.CalculateExactVelocity(specs.axial_bar_modenumber,
                                                              specs.axial_bar_E,specs.axial_bar_rho,
                                                              specs.axial_bar_v0,specs.axial_bar_L,time);
-                        PrintToFile("AxialBarVel.out")<<time<<"\t"<<Vmex<<"\t"<<Vmnum<<"\n";
+                        diagnostics.record("AxialBarVel",{"time","Vexact","Vnum"},{time,Vmex,Vmnum});
                         mpm_pc.CalculateEnergies(TKE,TSE);
                         TE=TKE+TSE;
-                        PrintToFile("AxialBarEnergy.out")<<time<<"\t"<<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                        diagnostics.record("AxialBarEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
                         break;
 
                     case(2):	//Dam break
                         mpm_pc.FindWaterFront(Xwf);
-                        PrintToFile("DamBreakWaterfront.out")<<time/sqrt(specs.dam_break_H1/specs.dam_break_g)
-                        <<"\t"<<Xwf/specs.dam_break_H1<<"\n";
+                        diagnostics.record("DamBreakWaterfront",{"time_nondim","Xwf_nondim"},
+                                           {time/sqrt(specs.dam_break_H1/specs.dam_break_g),Xwf/specs.dam_break_H1});
                         break;
 
                     case(3):	//Elastic collision of disks
                         mpm_pc.CalculateEnergies(TKE,TSE);
                         TE=TKE+TSE;
-                        PrintToFile("ElasticDiskCollisionEnergy.out")<<time<<"\t"
-                        <<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                        diagnostics.record("ElasticDiskCollisionEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
                         break;
 
                     case(4):	//Static deflection of beam under gravity
                         mpm_pc.CalculateVelocityCantilever(Vmnum);
                         Vmex = 0.0;
-                        PrintToFile("CantileverVel.out")<<time<<"\t"<<Vmex<<"\t"<<Vmnum<<"\n";
+                        diagnostics.record("CantileverVel",{"time","Vexact","Vnum"},{time,Vmex,Vmnum});
                         mpm_pc.CalculateEnergies(TKE,TSE);
                         TE=TKE+TSE;
-                        PrintToFile("CantileverEnergy.out")<<time<<"\t"<<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                        diagnostics.record("CantileverEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
                         break;
 
                     case(5):	//Transverse vibration of a bar
-                        mpm_pc.CalculateErrorTVB(specs.tvb_E,specs.tvb_v0,specs.tvb_L,specs.tvb_rho,err);
-                        PrintToFile("TVB_Error.out")<<time<<"\t"<<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                        mpm_pc.CalculateErrorTVB(specs.tvb_E,specs.tvb_v0,specs.tvb_L,specs.tvb_rho,time,err);
+                        diagnostics.record("TVB_Error",{"time","err"},{time,err});
                         break;
 
                     case(6):    //Check function reconstruction and convergence
@@ -428,13 +507,14 @@ int main (int argc, char* argv[])
                                                  specs.force_slab_hi,
                                                  specs.extforce,0,2,specs.mass_tolerance,
                                                  specs.order_scheme_directional,
-                                                 specs.periodic);
-                        CalculateSurfaceIntegralOnBG(geom, nodaldata,STRESS_INDEX,err);
-                        PrintToFile("Weight.out")<<time<<"\t"<<err<<"\t"<<-specs.total_mass*ACCG<<"\n";
+                                                 specs.periodic,
+                                                 &nodal.stress);
+                        CalculateSurfaceIntegralOnBG(geom, nodal.stress,STRESS_INDEX,err);
+                        diagnostics.record("Weight",{"time","weight","weight_exact"},{time,err,-specs.total_mass*ACCG});
                         break;
 
                     case(8): 	
-                        CalculateInterpolationError(geom, nodaldata,STRESS_INDEX);
+                        CalculateInterpolationError(geom, nodaldata,nodal.stress,STRESS_INDEX);
                         break;
 
                     case(9):    
@@ -459,7 +539,7 @@ int main (int argc, char* argv[])
             {
                 mpm_pc.CalculateEnergies(TKE,TSE);
                 TE=TKE+TSE;
-                PrintToFile("Energy.out")<<time<<"\t"<<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                diagnostics.record("Energy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
             }
         }
         PrintMessage(msg,print_length,false);
@@ -469,26 +549,55 @@ int main (int argc, char* argv[])
         PrintMessage(msg,print_length,true);
 
         amrex::Vector<std::string> nodaldata_names;
-        nodaldata_names.push_back("mass");
-        nodaldata_names.push_back("vel_x");
-        nodaldata_names.push_back("vel_y");
-        nodaldata_names.push_back("vel_z");
-        nodaldata_names.push_back("force_x");
-        nodaldata_names.push_back("force_y");
-        nodaldata_names.push_back("force_z");
-        nodaldata_names.push_back("delta_velx");
-        nodaldata_names.push_back("delta_vely");
-        nodaldata_names.push_back("delta_velz");
-        nodaldata_names.push_back("mass_old");
-        nodaldata_names.push_back("VELX_RIGID_INDEX");
-        nodaldata_names.push_back("VELY_RIGID_INDEX");
-        nodaldata_names.push_back("VELZ_RIGID_INDEX");
-        nodaldata_names.push_back("MASS_RIGID_INDEX");
-        nodaldata_names.push_back("STRESS_INDEX");
-        nodaldata_names.push_back("RIGID_BODY_ID");
-        nodaldata_names.push_back("NX");
-        nodaldata_names.push_back("NY");
-        nodaldata_names.push_back("NZ");
+        amrex::Vector<int> nodaldata_comps;
+        select_nodal_output_fields(specs.nodal_output_fields,nodal,nodaldata_names,nodaldata_comps);
+
+        if(specs.nodal_output_coarsen_ratio>1 && !ba.coarsenable(specs.nodal_output_coarsen_ratio))
+        {
+            amrex::Abort("\nGrids cannot be coarsened by mpm.nodal_output_coarsen_ratio. Please change max_grid_size");
+        }
+
+        //ParaView time indices for the native VTK output
+        mpm_vtk::PVDCollection particle_pvd;
+        mpm_vtk::PVDCollection grid_pvd;
+        if(specs.output_format!="plotfile")
+        {
+            particle_pvd.init(particle_output_folder+specs.prefix_particlefilename+".pvd",
+                              specs.restart_checkfile!="",time);
+            grid_pvd.init(grid_output_folder+specs.prefix_gridfilename+".pvd",
+                          specs.restart_checkfile!="",time);
+        }
+
+        //Probes give time series without writing full plotfiles
+        MPMProbes probes;
+        probes.read_probes(geom,nodal,specs.restart_checkfile!="");
+
+        //moving rigid bodies described by their signed distance
+        LevelsetBodies lsbodies;
+        lsbodies.read("lsbodies");
+        if(specs.restart_checkfile!="")
+        {
+            lsbodies.read_checkpoint(specs.restart_checkfile);
+        }
+
+        mpm_pc.set_sleeping(specs.sleep_steps,specs.sleep_velocity,
+                            specs.sleep_strainrate,specs.wake_velocity);
+
+        //particle sources that feed material in during the run
+        InflowSources inflow;
+        inflow.read("inflow",geom);
+        if(specs.calculate_strain_based_on_delta && !inflow.has_delta_form())
+        {
+            amrex::Abort("\nDelta strain form is not implemented for the constitutive model of an inflow source");
+        }
+        if(inflow.active() && specs.multirate_levels>1)
+        {
+            amrex::Abort("\nInflow sources are not supported with multirate_levels > 1");
+        }
+        if(specs.restart_checkfile!="")
+        {
+            inflow.read_checkpoint(specs.restart_checkfile);
+        }
         PrintMessage(msg,print_length,false);
 
 
@@ -497,13 +606,18 @@ int main (int argc, char* argv[])
         {
             msg="\n Writing initial particle and nodal data files";
             PrintMessage(msg,print_length,true);
-            mpm_pc.writeParticles(particle_output_folder+specs.prefix_particlefilename, specs.num_of_digits_in_filenames, steps);
-
-            pltfile = amrex::Concatenate(specs.prefix_gridfilename, steps,specs.num_of_digits_in_filenames);
-            write_grid_file(grid_output_folder+pltfile,nodaldata,nodaldata_names,geom,ba,dm,time);
+            WriteParticleAndGridFiles(specs,mpm_pc,nodal,nodaldata_names,nodaldata_comps,
+                                      geom,ba,dm,particle_output_folder,grid_output_folder,
+                                      particle_pvd,grid_pvd,steps,time);
 
             if(specs.phasefield_output)
             {
+                //the phase field is only needed here, so it is evaluated on demand
+                if(!specs.phasefield_every_step)
+                {
+                    mpm_pc.update_phase_field(phasefield_data,specs.phasefield_gridratio,
+                                              specs.phasefield_smoothfactor,specs.phasefield_kernel);
+                }
                 pltfile = amrex::Concatenate(phasefield_output_folder+specs.prefix_densityfilename, 
                                              steps, specs.num_of_digits_in_filenames);
                 WriteSingleLevelPlotfile(pltfile, phasefield_data, {"density"}, geom_phasefield, time, 0);
@@ -561,19 +675,99 @@ int main (int argc, char* argv[])
 
         amrex::Real vel_piston_old=0.0;
 
+        //material removed through outflow faces and sink regions
+        bool outflow_present=!specs.sink_regions.empty();
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            outflow_present=outflow_present || specs.bclo[d]==BC_OUTFLOW || specs.bchi[d]==BC_OUTFLOW;
+        }
+        Long outflow_count=0;
+        Real outflow_mass=0.0;
+        Real outflow_momentum[AMREX_SPACEDIM]={0.0,0.0,0.0};
+        bool particles_changed=false;
+
+        //dynamic relaxation state
+        Real qs_TKE_old=0.0;
+        Real qs_residual_max=0.0;
+        bool qs_converged=false;
+
+        //multi-rate state: substep within the current coarse step
+        int mr_nsub=1<<(specs.multirate_levels-1);
+        int mr_substep=0;
+
         while((steps < specs.maxsteps) and (time < specs.final_time))
         {
             auto iter_time_start = amrex::second();
-            dt 	= (specs.fixed_timestep==1)?specs.timestep:
-            mpm_pc.Calculate_time_step(specs.CFL,specs.dt_max_limit,specs.dt_min_limit);
+            //mass scaling by s raises the stable step by sqrt(s)
+            Real CFL_eff=specs.CFL*((specs.quasi_static)?std::sqrt(specs.qs_mass_scaling):1.0);
+            if(specs.multirate_levels==1)
+            {
+                dt 	= (specs.fixed_timestep==1)?specs.timestep:
+                mpm_pc.Next_time_step(CFL_eff,specs.dt_max_limit,specs.dt_min_limit);
+
+                //material injected at the end of this step is not in the particle estimate yet
+                if(inflow.active() && specs.fixed_timestep!=1)
+                {
+                    dt=amrex::max(amrex::min(dt,inflow.time_step(time,CFL_eff,specs.dt_max_limit)),
+                                  specs.dt_min_limit);
+                }
+            }
+            else
+            {
+                //dt is the finest step; a coarse step spans mr_nsub of them and every
+                //particle is binned at its start, when all levels are synchronised
+                if(mr_substep==0)
+                {
+                    dt 	= (specs.fixed_timestep==1)?specs.timestep:
+                    mpm_pc.Next_time_step(CFL_eff,specs.dt_max_limit,specs.dt_min_limit);
+                    mpm_pc.assign_multirate_levels(CFL_eff,dt*mr_nsub,specs.multirate_levels);
+                }
+
+                //level k updates at the end of each of its own steps
+                int kmin=0;
+                while(kmin<specs.multirate_levels-1 &&
+                      (mr_substep+1)%(1<<(specs.multirate_levels-1-kmin))!=0)
+                {
+                    kmin++;
+                }
+                mpm_pc.set_multirate_filter(specs.multirate_levels,kmin);
+                mr_substep=(mr_substep+1)%mr_nsub;
+            }
 
             time += dt;
             output_time += dt;
             output_timePrint += dt;
             steps++;
 
-            if (steps % specs.num_redist == 0)
+            //new material enters on the tiles owning its cells
+            if(inflow.active() && inflow.inject(mpm_pc,time,dt)>0)
+            {
+                particles_changed=true;
+            }
+
+            //removed particles are dropped by the first redistribution after
+            //they left and injected ones need their neighbours, so either
+            //forces a rebuild
+            if (steps % specs.num_redist == 0 || particles_changed)
             {
+                particles_changed=false;
+                if(specs.adapt_particles)
+                {
+                    Long nsplit=0;
+                    Long nmerged=0;
+                    mpm_pc.adapt_particles(specs.adapt_min_ppc,specs.adapt_max_ppc,
+                                           specs.adapt_split_stretch,specs.adapt_split_jacobian,
+                                           nsplit,nmerged);
+                    if(nsplit>0 && specs.calculate_strain_based_on_delta)
+                    {
+                        mpm_pc.check_delta_form_support();
+                    }
+                    if(diagnostics.due("ParticleAdaptation",steps))
+                    {
+                        diagnostics.record("ParticleAdaptation",{"time","split","merged"},
+                                           {time,Real(nsplit),Real(nmerged)});
+                    }
+                }
                 mpm_pc.RedistributeLocal();
                 mpm_pc.fillNeighbors();
                 mpm_pc.buildNeighborList(CheckPair());
@@ -583,7 +777,12 @@ int main (int argc, char* argv[])
                 mpm_pc.updateNeighbors();
             }
 
-            nodaldata.setVal(zero,ng_cells_nodaldata);
+            //ghost nodes are refilled by each gather
+            nodaldata.setVal(zero,0);
+            if(nodal.rigid.ok())
+            {
+                nodal.rigid.setVal(zero);
+            }
 
             //update_massvel=1, update_forces=0
             mpm_pc.deposit_onto_grid(	nodaldata,
@@ -616,12 +815,20 @@ int main (int argc, char* argv[])
                                      specs.periodic);
 
             //update velocity on nodes
-            nodal_update(nodaldata,dt,specs.mass_tolerance);
+            if(specs.quasi_static)
+            {
+                nodal_update_quasistatic(nodaldata,dt,specs.mass_tolerance,
+                                         specs.qs_mass_scaling,specs.qs_damping);
+            }
+            else
+            {
+                nodal_update(nodaldata,dt,specs.mass_tolerance);
+            }
 
             //Performing rigid body operations
             if(specs.ifrigidnodespresent==1)
             {
-                mpm_pc.deposit_onto_grid_rigidnodesonly(	nodaldata,
+                mpm_pc.deposit_onto_grid_rigidnodesonly(	nodal.rigid,
                                                         specs.gravity,
                                                         specs.external_loads_present,
                                                         specs.force_slab_lo,
@@ -641,37 +848,74 @@ int main (int argc, char* argv[])
                     }
                 }
 
-                //Calculate internal force on rigid bodies
-                //The following method is not generic. It is an approximation.
-                specs.Rb[0].force_internal[0]=0.0;
-                specs.Rb[0].force_internal[1]=-mpm_pc.CalculateEffectiveSpringConstant(specs.mem_compaction_area,specs.mem_compaction_L0);
-                specs.Rb[0].force_internal[2]=0.0;
-
-                for(int k=0;k<AMREX_SPACEDIM;k++)
+                //Calculate internal force on rigid bodies: the material load from
+                //the last contact pass, or for membrane compaction the effective
+                //spring force of the sample on body 0
+                for(int j=0;j<specs.no_of_rigidbodies_present;j++)
                 {
-                    specs.Rb[1].force_internal[k]=0.0;
+                    specs.Rb[j].force_internal=specs.Rb[j].force_contact;
                 }
+                if(specs.test_number==9)
+                {
+                    Real spring_const=0.0;
+                    specs.Rb[0].force_internal[0]=0.0;
+                    specs.Rb[0].force_internal[1]=-mpm_pc.CalculateEffectiveSpringConstant(specs.mem_compaction_area,
+                                                                                            specs.mem_compaction_L0,spring_const);
+                    specs.Rb[0].force_internal[2]=0.0;
+                    if(diagnostics.due("SpringConst",steps))
+                    {
+                        diagnostics.record("SpringConst",{"time","spring_const"},{time,spring_const});
+                    }
+                }
+
+                //6-DOF solver to get updated velocities, the motion of all
+                //bodies then goes to the device once
+                specs.SixDOF_Solver(dt);
+                specs.Pack_RigidBody_Motion(rigid_motion_h,dt);
+                Gpu::copy(Gpu::hostToDevice,rigid_motion_h.begin(),rigid_motion_h.end(),rigid_motion.begin());
 
-                //3-DOF solver to get updated velocities
-                specs.ThreeDOF_Solver(dt);
-                amrex::GpuArray<amrex::GpuArray<amrex::Real,AMREX_SPACEDIM>,numrigidbodies> velocity;
-                for(int j=0;j<numrigidbodies;j++)
+                mpm_pc.calculate_nodal_normal(nodal.rigid,specs.mass_tolerance,specs.order_scheme_directional,specs.periodic);
+                nodal_detect_contact(nodaldata,nodal.rigid,geom,specs.mass_tolerance,
+                                     specs.no_of_rigidbodies_present,rigid_motion,dt,rigid_load);
+                for(int j=0;j<specs.no_of_rigidbodies_present;j++)
                 {
                     for(int k=0;k<AMREX_SPACEDIM;k++)
                     {
-                        velocity[j][k]=specs.Rb[j].velocity[k];
+                        specs.Rb[j].force_contact[k]=rigid_load[2*AMREX_SPACEDIM*j+k];
+                        specs.Rb[j].torque_contact[k]=rigid_load[2*AMREX_SPACEDIM*j+AMREX_SPACEDIM+k];
                     }
                 }
-                mpm_pc.calculate_nodal_normal(nodaldata,specs.mass_tolerance,specs.order_scheme_directional,specs.periodic);
-                nodal_detect_contact(nodaldata,geom,specs.mass_tolerance,velocity);
-                for(int j=0;j<specs.no_of_rigidbodies_present;j++)
+
+                //rigid particles follow the rotation exactly, then the bodies move
+                mpm_pc.UpdateRigidParticleVelocities(specs.no_of_rigidbodies_present,rigid_motion,dt);
+                specs.RigidBody_Position_Update(dt);
+
+                if(diagnostics.due("RigidBodyContact",steps))
                 {
-                    mpm_pc.UpdateRigidParticleVelocities(j,specs.Rb[j].velocity);
+                    Vector<std::string> columns={"time"};
+                    Vector<Real> values={time};
+                    for(int j=0;j<specs.no_of_rigidbodies_present;j++)
+                    {
+                        for(int k=0;k<AMREX_SPACEDIM;k++)
+                        {
+                            columns.push_back("f"+std::string(1,"xyz"[k])+std::to_string(j));
+                            values.push_back(specs.Rb[j].force_contact[k]);
+                        }
+                        for(int k=0;k<AMREX_SPACEDIM;k++)
+                        {
+                            columns.push_back("t"+std::string(1,"xyz"[k])+std::to_string(j));
+                            values.push_back(specs.Rb[j].torque_contact[k]);
+                        }
+                    }
+                    diagnostics.record("RigidBodyContact",columns,values);
                 }
 
-                Real ymin;
-                ymin = mpm_pc.GetPosPiston();
-                PrintToFile("Spring.out")<<time<<"\t"<<ymin<<"\n";
+                if(diagnostics.due("Spring",steps))
+                {
+                    Real ymin;
+                    ymin = mpm_pc.GetPosPiston();
+                    diagnostics.record("Spring",{"time","ymin"},{time,ymin});
+                }
             }
 
             //impose bcs at nodes
@@ -684,36 +928,89 @@ int main (int argc, char* argv[])
                       specs.wall_vel_hi.data(),
                       dt);
 
+            //replace the explicit update by the backward Euler velocity,
+            //wall-constrained components are kept from nodal_bcs
+            if(specs.time_integration==1)
+            {
+                mpm_pc.implicit_velocity_solve(nodaldata,dt,specs.mass_tolerance,
+                                               specs.bclo.data(),specs.bchi.data(),
+                                               specs.order_scheme_directional,
+                                               specs.periodic,
+                                               specs.implicit_tol,specs.implicit_maxiter);
+            }
+
             if(mpm_ebtools::using_levelset_geometry)
             {
                 nodal_levelset_bcs(nodaldata,geom,dt,specs.levelset_bc,
                                    specs.levelset_wall_mu);
             }
 
+            if(lsbodies.active())
+            {
+                lsbodies.apply_contact(nodaldata,geom,specs.mass_tolerance,dt,true);
+            }
+
+            //per-body velocities where deformable bodies share nodes
+            if(specs.multifield_contact)
+            {
+                mpm_pc.multifield_contact(nodaldata,
+                                          specs.gravity,
+                                          specs.external_loads_present,
+                                          specs.force_slab_lo,
+                                          specs.force_slab_hi,
+                                          specs.extforce,
+                                          1,dt,specs.contact_mu,
+                                          specs.mass_tolerance,
+                                          specs.order_scheme_directional,
+                                          specs.periodic,
+                                          specs.bclo.data(),specs.bchi.data(),
+                                          specs.levelset_bc,
+                                          specs.wall_mu_lo.data(),
+                                          specs.wall_mu_hi.data(),
+                                          specs.wall_vel_lo.data(),
+                                          specs.wall_vel_hi.data(),
+                                          specs.levelset_wall_mu,
+                                          (nodal.rigid.ok())?&nodal.rigid:nullptr,
+                                          rigid_motion,lsbodies);
+            }
+
             //Calculate velocity diff
             store_delta_velocity(nodaldata);
 
-            //Update particle velocity at time t+dt
+            bool qs_check=(specs.quasi_static && steps>=specs.qs_min_steps);
+            if(qs_check && specs.qs_criterion==1 && steps%specs.qs_check_interval==0)
+            {
+                Real residual=nodal_residual_force_norm(nodaldata,dt,specs.mass_tolerance);
+                qs_residual_max=amrex::max(qs_residual_max,residual);
+                if(residual<=specs.qs_tol*qs_residual_max)
+                {
+                    qs_converged=true;
+                    amrex::Print()<<"\nQuasi-static residual force ratio "<<residual/qs_residual_max
+                                  <<" below tolerance at step "<<steps;
+                }
+            }
+
+            amrex::Real applied_strainrate=(time<specs.applied_strainrate_time)?specs.applied_strainrate:0.0;
+
+            //Update particle velocity and position at t+dt, and for USL also the
+            //strainrate, volume and stress, in a single sweep over the particles
+            int fused_stress=(specs.stress_update_scheme==1)?0:1;
             mpm_pc.updateNeighbors();
-            mpm_pc.interpolate_from_grid(	nodaldata,
-                                         1,
-                                         0,
-                                         specs.order_scheme_directional,
-                                         specs.periodic,
-                                         specs.alpha_pic_flip,
-                                         dt);
+            mpm_pc.advance_particles(nodaldata,dt,1,fused_stress,
+                                     specs.order_scheme_directional,
+                                     specs.periodic,
+                                     specs.alpha_pic_flip,
+                                     specs.bclo.data(),specs.bchi.data(),
+                                     specs.levelset_bc,
+                                     specs.wall_mu_lo.data(),
+                                     specs.wall_mu_hi.data(),
+                                     specs.wall_vel_lo.data(),
+                                     specs.wall_vel_hi.data(),
+                                     specs.levelset_wall_mu,
+                                     applied_strainrate,
+                                     specs.calculate_strain_based_on_delta);
             mpm_pc.updateNeighbors();
 
-            //Update particle position at t+dt
-            mpm_pc.moveParticles(	dt,
-                                 specs.bclo.data(),specs.bchi.data(),
-                                 specs.levelset_bc,
-                                 specs.wall_mu_lo.data(),
-                                 specs.wall_mu_hi.data(),
-                                 specs.wall_vel_lo.data(),
-                                 specs.wall_vel_hi.data(),
-                                 specs.levelset_wall_mu);
-
             if(specs.stress_update_scheme==1)										
             {
                 //MUSL scheme
@@ -739,7 +1036,6 @@ int main (int argc, char* argv[])
                           specs.wall_vel_lo.data(),
                           specs.wall_vel_hi.data(),
                           dt);
-                //nodal_bcs(	geom, nodaldata, dt);
 
                 if(mpm_ebtools::using_levelset_geometry)
                 {
@@ -748,46 +1044,127 @@ int main (int argc, char* argv[])
                                        specs.levelset_bc,
                                        specs.levelset_wall_mu);
                 }
-            }
 
-            //find strainrate at material points at time t+dt
-            mpm_pc.interpolate_from_grid(nodaldata,0,1,specs.order_scheme_directional,
-                                         specs.periodic,specs.alpha_pic_flip,dt);
-            mpm_pc.updateNeighbors();
+                if(lsbodies.active())
+                {
+                    lsbodies.apply_contact(nodaldata,geom,specs.mass_tolerance,dt,false);
+                }
 
-            //mpm_pc.move_particles_from_nodevel(nodaldata,dt,
-            //specs.bclo.data(),specs.bchi.data(),1);
-            mpm_pc.updateVolume(dt);
+                if(specs.multifield_contact)
+                {
+                    mpm_pc.multifield_contact(nodaldata,
+                                              specs.gravity,
+                                              specs.external_loads_present,
+                                              specs.force_slab_lo,
+                                              specs.force_slab_hi,
+                                              specs.extforce,
+                                              0,dt,specs.contact_mu,
+                                              specs.mass_tolerance,
+                                              specs.order_scheme_directional,
+                                              specs.periodic,
+                                              specs.bclo.data(),specs.bchi.data(),
+                                              specs.levelset_bc,
+                                              specs.wall_mu_lo.data(),
+                                              specs.wall_mu_hi.data(),
+                                              specs.wall_vel_lo.data(),
+                                              specs.wall_vel_hi.data(),
+                                              specs.levelset_wall_mu,
+                                              nullptr,
+                                              rigid_motion,lsbodies);
+                }
 
-            //update stress at material pointsat time t+dt
-            if(time<specs.applied_strainrate_time)
+                //strainrate, volume and stress at t+dt from the remapped velocity
+                mpm_pc.advance_particles(nodaldata,dt,0,1,
+                                         specs.order_scheme_directional,
+                                         specs.periodic,
+                                         specs.alpha_pic_flip,
+                                         specs.bclo.data(),specs.bchi.data(),
+                                         specs.levelset_bc,
+                                         specs.wall_mu_lo.data(),
+                                         specs.wall_mu_hi.data(),
+                                         specs.wall_vel_lo.data(),
+                                         specs.wall_vel_hi.data(),
+                                         specs.levelset_wall_mu,
+                                         applied_strainrate,
+                                         specs.calculate_strain_based_on_delta);
+                mpm_pc.updateNeighbors();
+            }
+
+            if(outflow_present)
             {
-                if(specs.calculate_strain_based_on_delta==1)
+                Real removed_mass=0.0;
+                Real removed_momentum[AMREX_SPACEDIM];
+                Long nremoved=mpm_pc.removed_particle_totals(removed_mass,removed_momentum);
+                particles_changed=(nremoved>0);
+                outflow_count+=nremoved;
+                outflow_mass+=removed_mass;
+                for(int d=0;d<AMREX_SPACEDIM;d++)
                 {
-                    mpm_pc.apply_constitutive_model_delta(dt,specs.applied_strainrate);
+                    outflow_momentum[d]+=removed_momentum[d];
                 }
-                else
+                if(diagnostics.due("Outflow",steps))
                 {
-                    mpm_pc.apply_constitutive_model(dt,specs.applied_strainrate);
+                    diagnostics.record("Outflow",{"time","removed_particles","removed_mass",
+                                                  "removed_momx","removed_momy","removed_momz"},
+                                       {time,Real(outflow_count),outflow_mass,
+                                        outflow_momentum[XDIR],outflow_momentum[YDIR],outflow_momentum[ZDIR]});
                 }
             }
-            else
+
+            //bodies move with the load taken from this step's contact
+            if(lsbodies.active())
+            {
+                lsbodies.advance(dt,specs.gravity.data());
+                lsbodies.record(diagnostics,steps,time);
+            }
+            if(inflow.active())
+            {
+                inflow.record(diagnostics,steps,time);
+            }
+            if(specs.sleep_steps>0 && diagnostics.due("Sleeping",steps))
             {
-                if(specs.calculate_strain_based_on_delta==1)
+                diagnostics.record("Sleeping",{"time","sleeping_particles"},
+                                   {time,Real(mpm_pc.sleeping_particle_count())});
+            }
+
+            //kinetic damping: reset velocities when the kinetic energy peaks,
+            //the peak energy is the convergence measure in that case
+            if(specs.quasi_static && (specs.qs_kinetic_damping || specs.qs_criterion==0))
+            {
+                Real TKE=0.0;
+                Real TSE=0.0;
+                mpm_pc.CalculateEnergies(TKE,TSE);
+                Real TKE_check=-1.0;
+
+                if(specs.qs_kinetic_damping)
                 {
-                    mpm_pc.apply_constitutive_model_delta(dt,0.0);
+                    if(TKE<qs_TKE_old)
+                    {
+                        mpm_pc.ResetMaterialParticleVelocities();
+                        TKE_check=qs_TKE_old;
+                        TKE=0.0;
+                    }
                 }
-                else
+                else if(steps%specs.qs_check_interval==0)
+                {
+                    TKE_check=TKE;
+                }
+                qs_TKE_old=TKE;
+
+                if(qs_check && specs.qs_criterion==0 && TKE_check>=0.0 && TKE_check<=specs.qs_tol*TSE)
                 {
-                    mpm_pc.apply_constitutive_model(dt,0.0);
+                    qs_converged=true;
+                    amrex::Print()<<"\nQuasi-static kinetic energy ratio "<<TKE_check/(TSE+TINYVAL)
+                                  <<" below tolerance at step "<<steps;
                 }
             }
 
-            if(specs.phasefield_output)
+            if(specs.phasefield_output && specs.phasefield_every_step)
             {
                 mpm_pc.update_phase_field(	phasefield_data,
                                             specs.phasefield_gridratio,
-                                            specs.phasefield_smoothfactor);
+                                            specs.phasefield_smoothfactor,
+                                            specs.phasefield_kernel);
             }
 
             if(specs.print_diagnostics)
@@ -812,51 +1189,69 @@ int main (int argc, char* argv[])
                     {
                         case(1):	
                             //Axial vibration of continuum bar
-                            mpm_pc.CalculateVelocity(Vmnum);
-                            Vmex = mpm_pc.CalculateExactVelocity(specs.axial_bar_modenumber,
-                                                                 specs.axial_bar_E,
-                                                                 specs.axial_bar_rho,
-                                                                 specs.axial_bar_v0,specs.axial_bar_L,time);
-
-                            PrintToFile("AxialBarVel.out")<<time<<"\t"<<Vmex<<"\t"<<Vmnum<<"\n";
-                            mpm_pc.CalculateEnergies(TKE,TSE);
-                            TE=TKE+TSE;
-                            PrintToFile("AxialBarEnergy.out")<<time<<"\t"<<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                            if(diagnostics.due("AxialBarVel",steps))
+                            {
+                                mpm_pc.CalculateVelocity(Vmnum);
+                                Vmex = mpm_pc.CalculateExactVelocity(specs.axial_bar_modenumber,
+                                                                     specs.axial_bar_E,
+                                                                     specs.axial_bar_rho,
+                                                                     specs.axial_bar_v0,specs.axial_bar_L,time);
+
+                                diagnostics.record("AxialBarVel",{"time","Vexact","Vnum"},{time,Vmex,Vmnum});
+                            }
+                            if(diagnostics.due("AxialBarEnergy",steps))
+                            {
+                                mpm_pc.CalculateEnergies(TKE,TSE);
+                                TE=TKE+TSE;
+                                diagnostics.record("AxialBarEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
+                            }
                             break;
 
                         case(2):	
                             //Dam break
-                            mpm_pc.FindWaterFront(Xwf);
-                            PrintToFile("DamBreakWaterfront.out")
-                            <<time/sqrt(specs.dam_break_H1/specs.dam_break_g)<<"\t"<<Xwf/specs.dam_break_H1<<"\n";
+                            if(diagnostics.due("DamBreakWaterfront",steps))
+                            {
+                                mpm_pc.FindWaterFront(Xwf);
+                                diagnostics.record("DamBreakWaterfront",{"time_nondim","Xwf_nondim"},
+                                                   {time/sqrt(specs.dam_break_H1/specs.dam_break_g),Xwf/specs.dam_break_H1});
+                            }
                             break;
 
                         case(3):	
                             //Elastic collision of disks
-                            mpm_pc.CalculateEnergies(TKE,TSE);
-                            TE=TKE+TSE;
-                            PrintToFile("ElasticDiskCollisionEnergy.out")<<time<<"\t"
-                            <<TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                            if(diagnostics.due("ElasticDiskCollisionEnergy",steps))
+                            {
+                                mpm_pc.CalculateEnergies(TKE,TSE);
+                                TE=TKE+TSE;
+                                diagnostics.record("ElasticDiskCollisionEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
+                            }
                             break;
 
                         case(4):	
                             //Static deflection of a beam under gravity
-                            mpm_pc.CalculateVelocityCantilever(Vmnum);
-                            Vmex = 0.0;
-                            PrintToFile("CantileverVel.out")<<time<<"\t"<<Vmex<<"\t"<<Vmnum<<"\n";
-                            mpm_pc.CalculateEnergies(TKE,TSE);
-                            TE=TKE+TSE;
-                            PrintToFile("CantileverEnergy.out")<<time<<"\t"<<TKE<<
-                            "\t"<<TSE<<"\t"<<TE<<"\n";
+                            if(diagnostics.due("CantileverVel",steps))
+                            {
+                                mpm_pc.CalculateVelocityCantilever(Vmnum);
+                                Vmex = 0.0;
+                                diagnostics.record("CantileverVel",{"time","Vexact","Vnum"},{time,Vmex,Vmnum});
+                            }
+                            if(diagnostics.due("CantileverEnergy",steps))
+                            {
+                                mpm_pc.CalculateEnergies(TKE,TSE);
+                                TE=TKE+TSE;
+                                diagnostics.record("CantileverEnergy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
+                            }
                             break;
 
                         case(5):	
                             //Transverse vibration of a bar
-                            mpm_pc.CalculateErrorTVB(specs.tvb_E,
-                                                     specs.tvb_v0,
-                                                     specs.tvb_L,specs.tvb_rho,err);
-                            PrintToFile("TVB_Error.out")<<time<<"\t"<<
-                            TKE<<"\t"<<TSE<<"\t"<<TE<<"\n";
+                            if(diagnostics.due("TVB_Error",steps))
+                            {
+                                mpm_pc.CalculateErrorTVB(specs.tvb_E,
+                                                         specs.tvb_v0,
+                                                         specs.tvb_L,specs.tvb_rho,time,err);
+                                diagnostics.record("TVB_Error",{"time","err"},{time,err});
+                            }
                             break;
 
                         case(6):    
@@ -868,21 +1263,25 @@ int main (int argc, char* argv[])
                         case(7):
                             //Checks the weight of a block of elastic solid. 
                             //Used to validate functionality to evaluate surface forces
-                            mpm_pc.deposit_onto_grid(nodaldata,
-                                                     specs.gravity,
-                                                     specs.external_loads_present,
-                                                     specs.force_slab_lo,
-                                                     specs.force_slab_hi,
-                                                     specs.extforce,0,2,specs.mass_tolerance,
-                                                     order_surface_integral,
-                                                     specs.periodic);
-                            CalculateSurfaceIntegralOnBG(geom, nodaldata,STRESS_INDEX,err);
-                            PrintToFile("Weight.out")<<time<<"\t"<<err<<
-                            "\t"<<-specs.total_mass*ACCG<<"\n";
+                            if(diagnostics.due("Weight",steps))
+                            {
+                                mpm_pc.deposit_onto_grid(nodaldata,
+                                                         specs.gravity,
+                                                         specs.external_loads_present,
+                                                         specs.force_slab_lo,
+                                                         specs.force_slab_hi,
+                                                         specs.extforce,0,2,specs.mass_tolerance,
+                                                         order_surface_integral,
+                                                         specs.periodic,
+                                                         &nodal.stress);
+                                CalculateSurfaceIntegralOnBG(geom, nodal.stress,STRESS_INDEX,err);
+                                diagnostics.record("Weight",{"time","weight","weight_exact"},
+                                                   {time,err,-specs.total_mass*ACCG});
+                            }
                             break;
 
                         case(8):    
-                            CalculateInterpolationError(geom, nodaldata,STRESS_INDEX);
+                            CalculateInterpolationError(geom, nodaldata,nodal.stress,STRESS_INDEX);
                             break;
 
                         case(9):
@@ -890,9 +1289,12 @@ int main (int argc, char* argv[])
 
                         case(10):	
                             //Get oscillations of a single spring under self weight
-                            ymax = mpm_pc.GetPosSpring()+specs.spring_alone_exact_delta;
-                            PrintToFile("Spring.out")<<time<<"\t"<<ymax<<
-                            "\t"<<specs.spring_alone_exact_deflection<<"\n";
+                            if(diagnostics.due("SpringAlone",steps))
+                            {
+                                ymax = mpm_pc.GetPosSpring()+specs.spring_alone_exact_delta;
+                                diagnostics.record("SpringAlone",{"time","ymax","deflection_exact"},
+                                                   {time,ymax,specs.spring_alone_exact_deflection});
+                            }
                             break;
 
                         default:	
@@ -904,13 +1306,20 @@ int main (int argc, char* argv[])
                 }
                 else
                 {
-                    mpm_pc.CalculateEnergies(TKE,TSE);
-                    TE=TKE+TSE;
-                    PrintToFile("Energy.out")<<time<<"\t"<<TKE<<
-                    "\t"<<TSE<<"\t"<<TE<<"\n";
+                    if(diagnostics.due("Energy",steps))
+                    {
+                        mpm_pc.CalculateEnergies(TKE,TSE);
+                        TE=TKE+TSE;
+                        diagnostics.record("Energy",{"time","TKE","TSE","TE"},{time,TKE,TSE,TE});
+                    }
                 }
             }
 
+            if(probes.active())
+            {
+                probes.sample(mpm_pc,nodaldata,geom,specs.order_scheme_directional,steps,time);
+            }
+
             if (fabs(output_time-specs.write_output_time)<dt*0.5)
             {
                 BL_PROFILE_VAR("OUTPUT_TIME",outputs);
@@ -919,13 +1328,9 @@ int main (int argc, char* argv[])
                 mpm_pc.fillNeighbors();
 
                 output_it++;
-                mpm_pc.writeParticles(particle_output_folder+specs.prefix_particlefilename, 
-                                      specs.num_of_digits_in_filenames, output_it);
-
-                pltfile = amrex::Concatenate(specs.prefix_gridfilename, 
-                                             output_it,specs.num_of_digits_in_filenames );
-
-                write_grid_file(grid_output_folder+pltfile,nodaldata,nodaldata_names,geom,ba,dm,time);
+                WriteParticleAndGridFiles(specs,mpm_pc,nodal,nodaldata_names,nodaldata_comps,
+                                          geom,ba,dm,particle_output_folder,grid_output_folder,
+                                          particle_pvd,grid_pvd,output_it,time);
 
                 if(specs.test_number==5)
                 {
@@ -935,6 +1340,11 @@ int main (int argc, char* argv[])
 
                 if(specs.phasefield_output)
                 {
+                    if(!specs.phasefield_every_step)
+                    {
+                        mpm_pc.update_phase_field(phasefield_data,specs.phasefield_gridratio,
+                                                  specs.phasefield_smoothfactor,specs.phasefield_kernel);
+                    }
                     pltfile = amrex::Concatenate(phasefield_output_folder+specs.prefix_densityfilename, 
                                                  output_it, 
                                                  specs.num_of_digits_in_filenames);
@@ -949,6 +1359,12 @@ int main (int argc, char* argv[])
                 mpm_pc.writeCheckpointFile(checkpoint_output_folder+specs.prefix_checkpointfilename, 
                                            specs.num_of_digits_in_filenames, 
                                            time,steps,output_it);
+                lsbodies.write_checkpoint(amrex::Concatenate(checkpoint_output_folder+specs.prefix_checkpointfilename,
+                                                             output_it,specs.num_of_digits_in_filenames));
+                inflow.write_checkpoint(amrex::Concatenate(checkpoint_output_folder+specs.prefix_checkpointfilename,
+                                                           output_it,specs.num_of_digits_in_filenames));
+                probes.flush();
+                diagnostics.flush();
             }
         
             auto time_per_iter=amrex::second()-iter_time_start;
@@ -960,18 +1376,21 @@ int main (int argc, char* argv[])
                 std::fixed<<std::setprecision(10)<<",\t Time/Iter = "<<time_per_iter<<"\n";
                 output_timePrint=zero;
             }
+
+            if(qs_converged)
+            {
+                break;
+            }
         }
 
+        probes.flush();
+        diagnostics.flush();
+
         mpm_pc.Redistribute();
         mpm_pc.fillNeighbors();
-        mpm_pc.writeParticles(particle_output_folder+specs.prefix_particlefilename, 
-                              specs.num_of_digits_in_filenames,output_it+1);
-
-        pltfile = amrex::Concatenate(specs.prefix_gridfilename, 
-                                     output_it+1, 
-                                     specs.num_of_digits_in_filenames);
-        
-        write_grid_file(grid_output_folder+pltfile,nodaldata,nodaldata_names,geom,ba,dm,time);
+        WriteParticleAndGridFiles(specs,mpm_pc,nodal,nodaldata_names,nodaldata_comps,
+                                  geom,ba,dm,particle_output_folder,grid_output_folder,
+                                  particle_pvd,grid_pvd,output_it+1,time);
         if(specs.print_diagnostics && 
            specs.is_standard_test && specs.test_number==4)
         {
@@ -980,6 +1399,11 @@ int main (int argc, char* argv[])
 
         if(specs.phasefield_output)
         {
+            if(!specs.phasefield_every_step)
+            {
+                mpm_pc.update_phase_field(phasefield_data,specs.phasefield_gridratio,
+                                          specs.phasefield_smoothfactor,specs.phasefield_kernel);
+            }
             pltfile = amrex::Concatenate(phasefield_output_folder+specs.prefix_densityfilename, 
                                          output_it+1, 
                                          specs.num_of_digits_in_filenames);
@@ -212,7 +212,8 @@ void MPMParticleContainer::FindWaterFront(Real &Xwf)
     wf_x = amrex::ReduceMax(*this, [=] 
     AMREX_GPU_HOST_DEVICE (const PType& p) -> Real 
     {
-        return(p.pos(XDIR));
+        //removed particles keep their exit position until the next Redistribute
+        return((p.id()>=0)?p.pos(XDIR):std::numeric_limits<amrex::Real>::lowest());
     });
 
 #ifdef BL_USE_MPI
@@ -222,12 +223,38 @@ void MPMParticleContainer::FindWaterFront(Real &Xwf)
     Xwf=wf_x;
 }
 
-void MPMParticleContainer::CalculateErrorTVB(Real tvb_E,Real tvb_v0,Real tvb_L,Real tvb_rho,Real err)
+void MPMParticleContainer::CalculateErrorTVB(Real tvb_E,Real tvb_v0,Real tvb_L,Real tvb_rho,Real time,Real &err)
 {
 	const Real pi = atan(1.0)*4.0;
 	Real c = sqrt(tvb_E/tvb_rho);
 	Real w0 = c*pi/tvb_L;
+	Real coswt = cos(w0*time);
 
+	//first mode: y=v0*L/(c*pi)*sin(w0*t)*sin(pi*x/L), so the transverse
+	//velocity is v0*cos(w0*t)*sin(pi*x/L); the error is the mass weighted
+	//L2 norm of the velocity difference relative to the mode amplitude
+	using PType = typename MPMParticleContainer::SuperParticleType;
+	Real err_num = amrex::ReduceSum(*this, [=]
+	AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+	{
+		Real vex = tvb_v0*coswt*sin(pi*p.pos(XDIR)/tvb_L);
+		Real dv = p.rdata(realData::yvel)-vex;
+		return(p.rdata(realData::mass)*dv*dv);
+	});
+
+	Real err_den = amrex::ReduceSum(*this, [=]
+	AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+	{
+		Real vmode = tvb_v0*sin(pi*p.pos(XDIR)/tvb_L);
+		return(p.rdata(realData::mass)*vmode*vmode);
+	});
+
+#ifdef BL_USE_MPI
+	ParallelDescriptor::ReduceRealSum(err_num);
+	ParallelDescriptor::ReduceRealSum(err_den);
+#endif
+
+	err=(err_den>0.0)?sqrt(err_num/err_den):sqrt(err_num);
 }
 
 void MPMParticleContainer::CalculateErrorP2G(MultiFab& nodaldata,amrex::Real p2g_L,amrex::Real p2g_f, int ncell)
@@ -364,7 +391,7 @@ void MPMParticleContainer::WriteDeflectionTVB(Real tvb_E,Real tvb_v0,Real tvb_L,
 
 }
 
-amrex::Real MPMParticleContainer::CalculateEffectiveSpringConstant(amrex::Real Area, amrex::Real L0)
+amrex::Real MPMParticleContainer::CalculateEffectiveSpringConstant(amrex::Real Area, amrex::Real L0, amrex::Real &spring_const)
 {
 	//First calculate the total strain energy
 	const int lev = 0;
@@ -422,7 +449,7 @@ amrex::Real MPMParticleContainer::CalculateEffectiveSpringConstant(amrex::Real A
 
 	}
 
-	PrintToFile("SpringConst.out")<<Calculated_Spring_Const<<"\n";
+	spring_const=Calculated_Spring_Const;
 
 	//Calculate and return the restoring force
 	return(Restoring_force);
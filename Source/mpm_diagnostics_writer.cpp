@@ -0,0 +1,179 @@
+#include <mpm_diagnostics_writer.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Utility.H>
+#include <fstream>
+#include <sstream>
+
+using namespace amrex;
+
+void DiagnosticsWriter::read_specs(const std::string &a_ppname, bool a_restarting,
+                                   const std::string &default_folder, const std::string &default_format)
+{
+    ppname=a_ppname;
+    restarting=a_restarting;
+    output_folder=default_folder;
+    format=default_format;
+
+    ParmParse pp(ppname);
+    pp.query("format",format);
+    pp.query("output_folder",output_folder);
+    pp.query("interval",default_interval);
+    pp.query("buffer_size",buffer_size);
+    pp.query("flush_time",flush_time);
+
+    if(format!="ascii" && format!="csv" && format!="binary")
+    {
+        amrex::Abort("\n"+ppname+".format should be ascii, csv or binary");
+    }
+    if(default_interval<1)
+    {
+        amrex::Abort("\n"+ppname+".interval should be at least 1");
+    }
+    if(output_folder.back()!='/')
+    {
+        output_folder+="/";
+    }
+    if(output_folder!="./")
+    {
+        amrex::UtilCreateDirectory(output_folder,0755);
+    }
+
+    last_flush=amrex::second();
+}
+
+int DiagnosticsWriter::interval(const std::string &name) const
+{
+    auto it=intervals.find(name);
+    if(it==intervals.end())
+    {
+        int n=default_interval;
+        ParmParse pp(ppname+"."+name);
+        pp.query("interval",n);
+        it=intervals.insert(std::make_pair(name,amrex::max(n,1))).first;
+    }
+    return(it->second);
+}
+
+bool DiagnosticsWriter::due(const std::string &name, int nstep) const
+{
+    return(nstep%interval(name)==0);
+}
+
+std::string DiagnosticsWriter::stream_name(const std::string &name) const
+{
+    std::string ext=(format=="binary")?".bin":((format=="csv")?".csv":".out");
+    return(output_folder+name+ext);
+}
+
+void DiagnosticsWriter::write_header(const std::string &name, const DiagnosticStream &ds)
+{
+    //on restart we keep appending to what the previous run wrote
+    std::ifstream existing(stream_name(name));
+    bool append=restarting && existing.good();
+    existing.close();
+    if(append)
+    {
+        return;
+    }
+
+    if(format=="binary")
+    {
+        //rows are raw doubles; the column names go to a sidecar file
+        std::ofstream ofs(stream_name(name),std::ofstream::trunc|std::ofstream::binary);
+        std::ofstream hdr(output_folder+name+".hdr",std::ofstream::trunc);
+        hdr<<ds.columns.size()<<"\n";
+        for(int c=0;c<ds.columns.size();c++)
+        {
+            hdr<<ds.columns[c]<<"\n";
+        }
+    }
+    else
+    {
+        std::ofstream ofs(stream_name(name),std::ofstream::trunc);
+        std::string sep=(format=="csv")?",":"\t";
+        ofs<<((format=="csv")?"":"#");
+        for(int c=0;c<ds.columns.size();c++)
+        {
+            ofs<<ds.columns[c]<<((c==ds.columns.size()-1)?"\n":sep);
+        }
+    }
+}
+
+void DiagnosticsWriter::record(const std::string &name, const Vector<std::string> &columns,
+                               const Vector<Real> &values)
+{
+    if(!ParallelDescriptor::IOProcessor())
+    {
+        return;
+    }
+
+    auto it=streams.find(name);
+    if(it==streams.end())
+    {
+        DiagnosticStream ds;
+        ds.columns=columns;
+        write_header(name,ds);
+        it=streams.insert(std::make_pair(name,ds)).first;
+    }
+    DiagnosticStream &ds=it->second;
+
+    if(values.size()!=ds.columns.size())
+    {
+        amrex::Abort("\nNumber of values does not match the columns of diagnostic "+name);
+    }
+
+    if(format=="binary")
+    {
+        for(int i=0;i<values.size();i++)
+        {
+            double v=values[i];
+            ds.buffer.append(reinterpret_cast<const char*>(&v),sizeof(double));
+        }
+    }
+    else
+    {
+        std::ostringstream row;
+        row.precision(10);
+        std::string sep=(format=="csv")?",":"\t";
+        for(int i=0;i<values.size();i++)
+        {
+            row<<values[i]<<((i==values.size()-1)?"\n":sep);
+        }
+        ds.buffer+=row.str();
+    }
+
+    if(long(ds.buffer.size())>=buffer_size)
+    {
+        flush(name,ds);
+    }
+    else if(amrex::second()-last_flush>=flush_time)
+    {
+        flush();
+    }
+}
+
+void DiagnosticsWriter::flush(const std::string &name, DiagnosticStream &ds)
+{
+    if(!ParallelDescriptor::IOProcessor() || ds.buffer.empty())
+    {
+        return;
+    }
+
+    std::ofstream ofs(stream_name(name),std::ofstream::app|std::ofstream::binary);
+    if(!ofs.good())
+    {
+        amrex::FileOpenFailed(stream_name(name));
+    }
+    ofs.write(ds.buffer.data(),ds.buffer.size());
+    ds.buffer.clear();
+}
+
+void DiagnosticsWriter::flush()
+{
+    for(auto &it : streams)
+    {
+        flush(it.first,it.second);
+    }
+    last_flush=amrex::second();
+}
@@ -2,6 +2,12 @@
 #include <AMReX_EB_utils.H>
 #include <AMReX_PlotFileUtil.H>
 #include <AMReX_MultiFabUtil.H>
+#include <AMReX_Scan.H>
+#include <AMReX_VisMF.H>
+#include <AMReX_Utility.H>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 
 namespace mpm_ebtools
 {
@@ -9,7 +15,266 @@ namespace mpm_ebtools
     MultiFab* lsphi=NULL;
     int ls_refinement=1;
     bool using_levelset_geometry=false;
+    int narrow_band_cells=3;
+    int band_drift_cells=1;
+    std::string levelset_cache_dir="";
+    LayoutData<int>* box_near_eb=NULL;
+    LayoutData<Gpu::DeviceVector<IntVect>>* band_nodes=NULL;
+
+    void build_narrow_band(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm)
+    {
+        BL_PROFILE("mpm_ebtools::build_narrow_band");
+
+        const auto dx=geom.CellSizeArray();
+        const int lsref=ls_refinement;
+        const amrex::Real dxmin=amrex::min(dx[XDIR],amrex::min(dx[YDIR],dx[ZDIR]));
+        const amrex::Real band=narrow_band_cells*dxmin;
+        //particles move less than a cell per step and stay with their box until
+        //the next redistribution, so boxes are kept that many cells beyond the band
+        const amrex::Real box_band=band+band_drift_cells*dxmin;
+
+        box_near_eb=new LayoutData<int>(ba,dm);
+        band_nodes=new LayoutData<Gpu::DeviceVector<IntVect>>(ba,dm);
+
+        Long nboxes_near=0;
+        Long nnodes_band=0;
+        for(MFIter mfi(*lsphi); mfi.isValid(); ++mfi)
+        {
+            const Box& lsbox=mfi.validbox();
+            const Box nodalbox=amrex::convert(ba[mfi.index()],IntVect::TheNodeVector());
+            Array4<Real const> lsarr=lsphi->const_array(mfi);
+
+            ReduceOps<ReduceOpMin> reduce_op;
+            ReduceData<Real> reduce_data(reduce_op);
+            using ReduceTuple = typename decltype(reduce_data)::Type;
+            reduce_op.eval(lsbox, reduce_data, [=]
+            AMREX_GPU_DEVICE (int i,int j,int k) -> ReduceTuple
+            {
+                return {amrex::Math::abs(lsarr(i,j,k))};
+            });
+            amrex::Real mindist=amrex::get<0>(reduce_data.value(reduce_op));
+
+            const auto nlo=amrex::lbound(nodalbox);
+            const auto nlen=amrex::length(nodalbox);
+            const int nnodes=nodalbox.numPts();
+
+            auto node_of=[=] AMREX_GPU_DEVICE (int n) -> IntVect
+            {
+                return(IntVect(nlo.x+n%nlen.x,nlo.y+(n/nlen.x)%nlen.y,nlo.z+n/(nlen.x*nlen.y)));
+            };
+            auto in_band=[=] AMREX_GPU_DEVICE (int n) -> int
+            {
+                IntVect iv=node_of(n);
+                //every wall node can carry mass, however deep
+                amrex::Real lsval=lsarr(iv[XDIR]*lsref,iv[YDIR]*lsref,iv[ZDIR]*lsref);
+                return(lsval<TINYVAL);
+            };
+
+            Gpu::DeviceVector<IntVect>& nodes=(*band_nodes)[mfi];
+            nodes.resize(nnodes);
+            IntVect* nodeptr=nodes.dataPtr();
+
+            int ncand=Scan::PrefixSum<int>(nnodes,
+            [=] AMREX_GPU_DEVICE (int n) -> int
+            {
+                return(in_band(n));
+            },
+            [=] AMREX_GPU_DEVICE (int n, int const& s)
+            {
+                if(in_band(n))
+                {
+                    nodeptr[s]=node_of(n);
+                }
+            },
+            Scan::Type::exclusive,Scan::retSum);
+            nodes.resize(ncand);
+            nodes.shrink_to_fit();
+
+            (*box_near_eb)[mfi]=(mindist<box_band || ncand>0)?1:0;
+            nboxes_near += (*box_near_eb)[mfi];
+            nnodes_band += ncand;
+        }
+
+#ifdef BL_USE_MPI
+        ParallelDescriptor::ReduceLongSum(nboxes_near);
+        ParallelDescriptor::ReduceLongSum(nnodes_band);
+#endif
+        amrex::Print()<<"\n Level-set narrow band: "<<nboxes_near<<" of "<<ba.size()
+                      <<" boxes, "<<nnodes_band<<" wall nodes";
+    }
     
+    int levelset_coarsening_level()
+    {
+        int required_coarsening_level = 0;
+        if (ls_refinement > 1) 
+        {
+            int tmp = ls_refinement;
+            while (tmp >>= 1) ++required_coarsening_level;
+        }
+        return(required_coarsening_level);
+    }
+
+    //Signed distance on the level-set grid from the EB index space last built
+    void fill_levelset_from_eb(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm,int nghost)
+    {
+        Box dom_ls = geom.Domain();
+        dom_ls.refine(ls_refinement);
+        Geometry geom_ls(dom_ls);
+
+        const EB2::IndexSpace & ebis   = EB2::IndexSpace::top();
+        const EB2::Level &      eblev  = ebis.getLevel(geom);
+        //create lslev
+        const EB2::Level & lslev = ebis.getLevel(geom_ls);
+
+        //build factory
+        ebfactory = new EBFArrayBoxFactory(eblev, geom, ba, dm,
+                                           {nghost, nghost,nghost}, 
+                                           EBSupport::full);
+
+        //create nodal multifab with level-set refinement
+        BoxArray ls_ba = amrex::convert(ba, IntVect::TheNodeVector());
+        ls_ba.refine(ls_refinement);
+        lsphi = new MultiFab;
+        lsphi->define(ls_ba, dm, 1, nghost);
+
+        //call signed distance
+        amrex::FillSignedDistance (*lsphi,lslev,*ebfactory,ls_refinement);
+    }
+
+    //Solids listed in <prefix>.objects, each <prefix>.<name> a plane, box,
+    //sphere or cylinder combined in order with the objects listed before it
+    CSGIF read_csg_objects(const std::string &prefix)
+    {
+        Vector<std::string> objects;
+        ParmParse pp(prefix);
+        pp.getarr("objects",objects);
+        if(objects.empty())
+        {
+            amrex::Abort("\nPlease list at least one object in "+prefix+".objects");
+        }
+
+        CSGIF csg;
+        for(int n=0;n<objects.size();n++)
+        {
+            CSGPrimitive prim;
+            ParmParse ppo(prefix+"."+objects[n]);
+            std::string type;
+            std::string operation="union";
+            ppo.get("type",type);
+            ppo.query("operation",operation);
+            ppo.query("solid_inside",prim.solid_inside);
+
+            Vector<amrex::Real> vec;
+            if(type=="plane")
+            {
+                prim.type=CSG_PLANE;
+                ppo.getarr("point",vec,0,AMREX_SPACEDIM);
+                std::copy(vec.begin(),vec.end(),prim.center);
+                ppo.getarr("normal",vec,0,AMREX_SPACEDIM);
+                amrex::Real nmag=std::sqrt(vec[XDIR]*vec[XDIR]+vec[YDIR]*vec[YDIR]+vec[ZDIR]*vec[ZDIR]);
+                if(nmag<TINYVAL)
+                {
+                    amrex::Abort("\nZero normal for CSG plane "+objects[n]);
+                }
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    prim.normal[d]=vec[d]/nmag;
+                }
+            }
+            else if(type=="box")
+            {
+                prim.type=CSG_BOX;
+                ppo.getarr("lo",vec,0,AMREX_SPACEDIM);
+                std::copy(vec.begin(),vec.end(),prim.lo);
+                ppo.getarr("hi",vec,0,AMREX_SPACEDIM);
+                std::copy(vec.begin(),vec.end(),prim.hi);
+            }
+            else if(type=="sphere")
+            {
+                prim.type=CSG_SPHERE;
+                ppo.getarr("center",vec,0,AMREX_SPACEDIM);
+                std::copy(vec.begin(),vec.end(),prim.center);
+                ppo.get("radius",prim.radius);
+            }
+            else if(type=="cylinder")
+            {
+                prim.type=CSG_CYLINDER;
+                ppo.getarr("center",vec,0,AMREX_SPACEDIM);
+                std::copy(vec.begin(),vec.end(),prim.center);
+                ppo.get("radius",prim.radius);
+                ppo.query("height",prim.height);
+                ppo.query("direction",prim.direction);
+                if(prim.direction<0 || prim.direction>=AMREX_SPACEDIM)
+                {
+                    amrex::Abort("\nCSG cylinder direction should be 0, 1 or 2");
+                }
+            }
+            else
+            {
+                amrex::Abort("\nUnknown CSG object type "+type+" (plane, box, sphere or cylinder)");
+            }
+
+            if(operation=="union")
+            {
+                prim.operation=CSG_UNION;
+            }
+            else if(operation=="intersect")
+            {
+                prim.operation=CSG_INTERSECT;
+            }
+            else if(operation=="subtract")
+            {
+                prim.operation=CSG_SUBTRACT;
+            }
+            else
+            {
+                amrex::Abort("\nUnknown CSG operation "+operation+" (union, intersect or subtract)");
+            }
+            csg.add(prim);
+        }
+        return(csg);
+    }
+
+    //Walls from the csg.* description
+    void make_csg_levelset(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm,int nghost)
+    {
+        BL_PROFILE("mpm_ebtools::make_csg_levelset");
+
+        CSGIF csg=read_csg_objects("csg");
+
+        Box dom_ls = geom.Domain();
+        dom_ls.refine(ls_refinement);
+        Geometry geom_ls(dom_ls);
+        auto csg_gshop = EB2::makeShop(csg);
+        EB2::Build(csg_gshop, geom_ls, levelset_coarsening_level(), 10);
+
+        fill_levelset_from_eb(geom,ba,dm,nghost);
+        amrex::Print()<<"\n Level set built from "<<csg.size()<<" CSG objects";
+    }
+
+    //Walls from a triangulated surface, eb2.stl_file with the EB2 stl_scale,
+    //stl_center and stl_reverse_normal options
+    void make_stl_levelset(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm,int nghost)
+    {
+        BL_PROFILE("mpm_ebtools::make_stl_levelset");
+
+        std::string stl_file;
+        ParmParse pp("eb2");
+        pp.get("stl_file",stl_file);
+        if(!amrex::FileExists(stl_file))
+        {
+            amrex::Abort("\nCannot find STL file "+stl_file);
+        }
+
+        Box dom_ls = geom.Domain();
+        dom_ls.refine(ls_refinement);
+        Geometry geom_ls(dom_ls);
+        amrex::EB2::Build(geom_ls, levelset_coarsening_level(), 10);
+
+        fill_levelset_from_eb(geom,ba,dm,nghost);
+        amrex::Print()<<"\n Level set built from "<<stl_file;
+    }
+
     void make_wedge_hopper_levelset(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm)
     {
         int ls_ref = ls_refinement;
@@ -103,7 +368,128 @@ namespace mpm_ebtools
 
     }
 
-    void init_eb(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm)
+    //Description of everything the signed distance depends on: the EB and
+    //hopper inputs, the domain and the level-set refinement
+    std::string levelset_cache_key(const Geometry &geom)
+    {
+        std::ostringstream table;
+        ParmParse::dumpTable(table,true);
+
+        Vector<std::string> entries;
+        std::istringstream lines(table.str());
+        std::string line;
+        while(std::getline(lines,line))
+        {
+            bool eb_input=(line.find("eb2.")!=std::string::npos ||
+                           line.find("wedge_hopper.")!=std::string::npos ||
+                           line.find("csg.")!=std::string::npos);
+            bool cache_input=(line.find("levelset_cache")!=std::string::npos ||
+                              line.find("narrow_band_cells")!=std::string::npos);
+            if(eb_input && !cache_input)
+            {
+                entries.push_back(line);
+            }
+        }
+        std::sort(entries.begin(),entries.end());
+
+        std::ostringstream key;
+        key<<std::setprecision(17);
+        key<<"domain "<<geom.Domain()<<"\n";
+        key<<"prob_lo "<<geom.ProbLo(XDIR)<<" "<<geom.ProbLo(YDIR)<<" "<<geom.ProbLo(ZDIR)<<"\n";
+        key<<"prob_hi "<<geom.ProbHi(XDIR)<<" "<<geom.ProbHi(YDIR)<<" "<<geom.ProbHi(ZDIR)<<"\n";
+        key<<"ls_refinement "<<ls_refinement<<"\n";
+        for(int n=0;n<entries.size();n++)
+        {
+            key<<entries[n]<<"\n";
+        }
+
+        //an edited surface file keeps its name, so its contents go in the key
+        std::string stl_file="";
+        ParmParse pp("eb2");
+        pp.query("stl_file",stl_file);
+        if(!stl_file.empty() && amrex::FileExists(stl_file))
+        {
+            Vector<char> contents;
+            ParallelDescriptor::ReadAndBcastFile(stl_file,contents);
+            key<<"stl_contents "<<std::hex
+               <<std::hash<std::string>{}(std::string(contents.begin(),contents.end()))<<"\n";
+        }
+        return(key.str());
+    }
+
+    std::string levelset_cache_path(const std::string &key)
+    {
+        std::ostringstream name;
+        name<<levelset_cache_dir<<"/lsphi_"<<std::hex<<std::hash<std::string>{}(key);
+        return(name.str());
+    }
+
+    bool read_levelset_cache(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm,int nghost)
+    {
+        if(levelset_cache_dir.empty())
+        {
+            return(false);
+        }
+        const std::string key=levelset_cache_key(geom);
+        const std::string path=levelset_cache_path(key);
+
+        //the key file guards against hash collisions and stale entries
+        int found=0;
+        if(ParallelDescriptor::IOProcessor())
+        {
+            std::ifstream keyfile(path+"/key");
+            if(keyfile.good())
+            {
+                std::stringstream stored;
+                stored<<keyfile.rdbuf();
+                found=(stored.str()==key)?1:0;
+            }
+        }
+        ParallelDescriptor::Bcast(&found,1,ParallelDescriptor::IOProcessorNumber());
+        if(!found)
+        {
+            return(false);
+        }
+
+        BoxArray ls_ba = amrex::convert(ba, IntVect::TheNodeVector());
+        ls_ba.refine(ls_refinement);
+        lsphi = new MultiFab;
+        lsphi->define(ls_ba, dm, 1, nghost);
+
+        //the cached layout may come from another max_grid_size or rank count
+        MultiFab cached;
+        VisMF::Read(cached,path+"/lsphi");
+        lsphi->ParallelCopy(cached,0,0,1,cached.nGrowVect(),lsphi->nGrowVect());
+
+        amrex::Print()<<"\n Level set read from cache "<<path;
+        return(true);
+    }
+
+    void write_levelset_cache(const Geometry &geom)
+    {
+        if(levelset_cache_dir.empty())
+        {
+            return;
+        }
+        const std::string key=levelset_cache_key(geom);
+        const std::string path=levelset_cache_path(key);
+
+        if(ParallelDescriptor::IOProcessor())
+        {
+            amrex::UtilCreateDirectory(path,0755);
+        }
+        ParallelDescriptor::Barrier();
+        VisMF::Write(*lsphi,path+"/lsphi");
+        if(ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream keyfile(path+"/key");
+            keyfile<<key;
+        }
+        amrex::Print()<<"\n Level set written to cache "<<path;
+    }
+
+    void init_eb(const Geometry &geom,const BoxArray &ba,const DistributionMapping &dm,
+                 int drift_cells,int stencil_cells)
     {
         int nghost = 1;
         std::string geom_type="all_regular";
@@ -111,52 +497,50 @@ namespace mpm_ebtools
 
         pp.query("geom_type",geom_type);
         pp.query("ls_refinement",ls_refinement);
+        pp.query("narrow_band_cells",narrow_band_cells);
+        if(narrow_band_cells<stencil_cells)
+        {
+            amrex::Print()<<"\n eb2.narrow_band_cells raised to the stencil reach of "<<stencil_cells;
+            narrow_band_cells=stencil_cells;
+        }
+        band_drift_cells=drift_cells;
+        pp.query("levelset_cache",levelset_cache_dir);
 
         if(geom_type!="all_regular")
         {
-            if(geom_type=="wedge_hopper")
+            using_levelset_geometry=true;
+            //the EB itself is only needed to compute the signed distance,
+            //a cached level set skips it entirely
+            if(!read_levelset_cache(geom,ba,dm,nghost))
             {
-                using_levelset_geometry=true;
-                make_wedge_hopper_levelset(geom,ba,dm);
-            }
-            else
-            {
-                using_levelset_geometry=true;
-                int required_coarsening_level = 0;
-                int max_coarsening_level=10;
-                if (ls_refinement > 1) 
+                if(geom_type=="wedge_hopper")
+                {
+                    make_wedge_hopper_levelset(geom,ba,dm);
+                }
+                else if(geom_type=="csg")
                 {
-                    int tmp = ls_refinement;
-                    while (tmp >>= 1) ++required_coarsening_level;
+                    make_csg_levelset(geom,ba,dm,nghost);
                 }
-                Box dom_ls = geom.Domain();
-                dom_ls.refine(ls_refinement);
-                Geometry geom_ls(dom_ls);
-                amrex::EB2::Build(geom_ls, required_coarsening_level, max_coarsening_level);
-
-                const EB2::IndexSpace & ebis   = EB2::IndexSpace::top();
-                const EB2::Level &      eblev  = ebis.getLevel(geom);
-                //create lslev
-                const EB2::Level & lslev = ebis.getLevel(geom_ls);
-
-                //build factory
-                ebfactory = new EBFArrayBoxFactory(eblev, geom, ba, dm,
-                                                   {nghost, nghost,nghost}, 
-                                                   EBSupport::full);
-
-                //create nodal multifab with level-set refinement
-                BoxArray ls_ba = amrex::convert(ba, IntVect::TheNodeVector());
-                ls_ba.refine(ls_refinement);
-                lsphi = new MultiFab;
-                lsphi->define(ls_ba, dm, 1, nghost);
-
-                //call signed distance
-                amrex::FillSignedDistance (*lsphi,lslev,*ebfactory,ls_refinement);
+                else if(geom_type=="stl")
+                {
+                    make_stl_levelset(geom,ba,dm,nghost);
+                }
+                else
+                {
+                    Box dom_ls = geom.Domain();
+                    dom_ls.refine(ls_refinement);
+                    Geometry geom_ls(dom_ls);
+                    amrex::EB2::Build(geom_ls, levelset_coarsening_level(), 10);
+                    fill_levelset_from_eb(geom,ba,dm,nghost);
+                }
+                write_levelset_cache(geom);
             }
         }
 
         if(using_levelset_geometry)
         { 
+            build_narrow_band(geom,ba,dm);
+
             const std::string& pltfile = "ebplt";
             Box dom_ls = geom.Domain();
             dom_ls.refine(ls_refinement);
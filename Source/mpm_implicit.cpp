@@ -0,0 +1,328 @@
+#include <mpm_particle_container.H>
+#include <interpolants.H>
+#include <nodal_data_ops.H>
+#include <constitutive_models.H>
+#include <AMReX_MultiFabUtil.H>
+
+//Components of the work array used by the implicit solver
+#define IMPL_X 0
+#define IMPL_R 3
+#define IMPL_P 6
+#define IMPL_AP 9
+#define IMPL_MASK 12
+#define IMPL_NCOMP 15
+
+void MPMParticleContainer::implicit_stiffness_product(MultiFab& work,int vcomp,int outcomp,
+                                                      GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
+                                                      GpuArray<int,AMREX_SPACEDIM> periodic)
+{
+    BL_PROFILE("MPMParticleContainer::implicit_stiffness_product");
+
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    auto& plev  = GetParticles(lev);
+    const auto dxi = geom.InvCellSizeArray();
+    const auto dx = geom.CellSizeArray();
+    const auto plo = geom.ProbLoArray();
+    const auto domain = geom.Domain();
+
+    const int* loarr = domain.loVect ();
+    const int* hiarr = domain.hiVect ();
+
+    int lo[]={loarr[0],loarr[1],loarr[2]};
+    int hi[]={hiarr[0],hiarr[1],hiarr[2]};
+
+    work.setVal(zero,outcomp,AMREX_SPACEDIM,0);
+    fill_nodal_ghosts(work,geom,vcomp,AMREX_SPACEDIM,nodal_gather_ghosts(order_scheme_directional,0));
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        const amrex::Box& box = mfi.tilebox();
+        Box nodalbox = convert(box, {1, 1, 1});
+
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        int np = aos.numRealParticles();
+        int ng =aos.numNeighborParticles();
+        int nt = np+ng;
+
+        Array4<Real> work_arr=work.array(mfi);
+
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(nt,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            int lmin,lmax,nmin,nmax,mmin,mmax;
+
+            ParticleType& p = pstruct[i];
+
+            if(p.idata(intData::phase)==0)
+            {
+                amrex::Real xp[AMREX_SPACEDIM];
+                amrex::Real gradvp[AMREX_SPACEDIM][AMREX_SPACEDIM]={{0.0}};
+
+                xp[XDIR]=p.pos(XDIR);
+                xp[YDIR]=p.pos(YDIR);
+                xp[ZDIR]=p.pos(ZDIR);
+
+                auto iv = getParticleCell(p, plo, dxi, domain);
+
+                lmin=(order_scheme_directional[0]==1)?0:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?0:((iv[XDIR]==hi[XDIR])?-1:-1):-1000);
+                lmax=(order_scheme_directional[0]==1)?2:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?lmin+3:((iv[XDIR]==hi[XDIR])?lmin+3:lmin+4):-1000);
+
+                mmin=(order_scheme_directional[1]==1)?0:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?0:((iv[YDIR]==hi[YDIR])?-1:-1):-1000);
+                mmax=(order_scheme_directional[1]==1)?2:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?mmin+3:((iv[YDIR]==hi[YDIR])?mmin+3:mmin+4):-1000);
+
+                nmin=(order_scheme_directional[2]==1)?0:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?0:((iv[ZDIR]==hi[ZDIR])?-1:-1):-1000);
+                nmax=(order_scheme_directional[2]==1)?2:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?nmin+3:((iv[ZDIR]==hi[ZDIR])?nmin+3:nmin+4):-1000);
+
+                if(lmin==-1000 or lmax==-1000 or mmin==-1000 or mmax==-1000 or nmin==-1000 or nmax==-1000)
+                {
+                    amrex::Abort("\nError. Something wrong with min/max index values in implicit stiffness product");
+                }
+
+                //G2P: velocity gradient of the trial field
+                for(int n=nmin;n<nmax;n++)
+                {
+                    for(int m=mmin;m<mmax;m++)
+                    {
+                        for(int l=lmin;l<lmax;l++)
+                        {
+                            amrex::Real basisval_grad[AMREX_SPACEDIM];
+                            for(int d=0;d<AMREX_SPACEDIM;d++)
+                            {
+                                basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                            }
+                            for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+                            {
+                                for(int d2=0;d2<AMREX_SPACEDIM;d2++)
+                                {
+                                    gradvp[d1][d2]+=work_arr(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n,vcomp+d1)*basisval_grad[d2];
+                                }
+                            }
+                        }
+                    }
+                }
+
+                //Tangent stress of the trial strain, linearised about the current state
+                amrex::Real eps[NCOMP_TENSOR];
+                amrex::Real dsigma[NCOMP_TENSOR];
+                int ind=0;
+                for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+                {
+                    for(int d2=d1;d2<AMREX_SPACEDIM;d2++)
+                    {
+                        eps[ind]=half*(gradvp[d1][d2]+gradvp[d2][d1]);
+                        ind++;
+                    }
+                }
+
+                if(p.idata(intData::constitutive_model)==1)
+                {
+                    amrex::Real dp=p.rdata(realData::Bulk_modulus)*(eps[XX]+eps[YY]+eps[ZZ]);
+                    for(int c=0;c<NCOMP_TENSOR;c++)
+                    {
+                        dsigma[c]=zero;
+                    }
+                    dsigma[XX]=dp;
+                    dsigma[YY]=dp;
+                    dsigma[ZZ]=dp;
+                }
+                else
+                {
+                    linear_elastic(eps,dsigma,p.rdata(realData::E),p.rdata(realData::nu));
+                }
+
+                amrex::Real stress_tens[AMREX_SPACEDIM*AMREX_SPACEDIM];
+                ind=0;
+                for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+                {
+                    for(int d2=d1;d2<AMREX_SPACEDIM;d2++)
+                    {
+                        stress_tens[d1*AMREX_SPACEDIM+d2]=dsigma[ind];
+                        stress_tens[d2*AMREX_SPACEDIM+d1]=dsigma[ind];
+                        ind++;
+                    }
+                }
+
+                //P2G: nodal force of the trial stress
+                for(int n=nmin;n<nmax;n++)
+                {
+                    for(int m=mmin;m<mmax;m++)
+                    {
+                        for(int l=lmin;l<lmax;l++)
+                        {
+                            IntVect ivlocal(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n);
+
+                            if(nodalbox.contains(ivlocal))
+                            {
+                                amrex::Real basisval_grad[AMREX_SPACEDIM];
+                                for(int d=0;d<AMREX_SPACEDIM;d++)
+                                {
+                                    basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                                }
+
+                                amrex::Real tensvect[AMREX_SPACEDIM];
+                                tensor_vector_pdt(stress_tens,basisval_grad,tensvect);
+
+                                for(int dim=0;dim<AMREX_SPACEDIM;dim++)
+                                {
+                                    amrex::Gpu::Atomic::AddNoRet(&work_arr(ivlocal,outcomp+dim),
+                                                                 p.rdata(realData::volume)*tensvect[dim]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+void MPMParticleContainer::implicit_velocity_solve(MultiFab& nodaldata,const amrex::Real& dt,
+                                                   amrex::Real mass_tolerance,
+                                                   int bclo[AMREX_SPACEDIM],int bchi[AMREX_SPACEDIM],
+                                                   GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
+                                                   GpuArray<int,AMREX_SPACEDIM> periodic,
+                                                   amrex::Real tol,int maxiter)
+{
+    BL_PROFILE("MPMParticleContainer::implicit_velocity_solve");
+
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    const auto domain = geom.Domain();
+    const int* loarr = domain.loVect ();
+    const int* hiarr = domain.hiVect ();
+
+    int lo[]={loarr[0],loarr[1],loarr[2]};
+    int hi[]={hiarr[0],hiarr[1],hiarr[2]};
+
+    GpuArray<int,AMREX_SPACEDIM> bc_lo_arr;
+    GpuArray<int,AMREX_SPACEDIM> bc_hi_arr;
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        bc_lo_arr[d]=bclo[d];
+        bc_hi_arr[d]=bchi[d];
+    }
+
+    MultiFab work(nodaldata.boxArray(),nodaldata.DistributionMap(),IMPL_NCOMP,nodaldata.nGrowVect());
+    work.setVal(zero);
+
+    //x starts from the explicit velocity; the mask removes empty nodes and
+    //wall-constrained components from the system
+    for(MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    {
+        const Box& nodalbox=mfi.validbox();
+        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> work_arr=work.array(mfi);
+
+        amrex::ParallelFor(nodalbox,[=]
+        AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+        {
+            int ijk[]={i,j,k};
+            bool hasmass=(nodal_data_arr(i,j,k,MASS_INDEX)>=mass_tolerance);
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                bool fixed=!hasmass;
+                for(int dir=0;dir<AMREX_SPACEDIM;dir++)
+                {
+                    int bc=(ijk[dir]==lo[dir])?bc_lo_arr[dir]:((ijk[dir]==hi[dir]+1)?bc_hi_arr[dir]:BC_PERIODIC);
+                    if(bc==BC_NOSLIPWALL || ((bc==BC_SLIPWALL || bc==BC_PARTIALSLIPWALL) && d==dir))
+                    {
+                        fixed=true;
+                    }
+                }
+                work_arr(i,j,k,IMPL_MASK+d)=(fixed)?zero:one;
+                work_arr(i,j,k,IMPL_X+d)=(hasmass)?nodal_data_arr(i,j,k,VELX_INDEX+d):zero;
+            }
+        });
+    }
+
+    auto owner_mask=amrex::OwnerMask(work,geom.periodicity());
+    amrex::Real dt2=dt*dt;
+
+    //out = mask*(M v + dt^2 K v)
+    auto apply_operator=[&](int incomp,int outcomp)
+    {
+        implicit_stiffness_product(work,incomp,outcomp,order_scheme_directional,periodic);
+        for(MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+        {
+            const Box& nodalbox=mfi.validbox();
+            Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+            Array4<Real> work_arr=work.array(mfi);
+
+            amrex::ParallelFor(nodalbox,[=]
+            AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+            {
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    work_arr(i,j,k,outcomp+d)=work_arr(i,j,k,IMPL_MASK+d)*
+                    (nodal_data_arr(i,j,k,MASS_INDEX)*work_arr(i,j,k,incomp+d)+dt2*work_arr(i,j,k,outcomp+d));
+                }
+            });
+        }
+    };
+
+    //r = M v_expl - A x0 = -dt^2 K x0 on free components
+    implicit_stiffness_product(work,IMPL_X,IMPL_R,order_scheme_directional,periodic);
+    for(MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    {
+        const Box& nodalbox=mfi.validbox();
+        Array4<Real> work_arr=work.array(mfi);
+
+        amrex::ParallelFor(nodalbox,[=]
+        AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+        {
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                work_arr(i,j,k,IMPL_R+d)=-dt2*work_arr(i,j,k,IMPL_MASK+d)*work_arr(i,j,k,IMPL_R+d);
+                work_arr(i,j,k,IMPL_P+d)=work_arr(i,j,k,IMPL_R+d);
+            }
+        });
+    }
+
+    amrex::Real rr=MultiFab::Dot(*owner_mask,work,IMPL_R,work,IMPL_R,AMREX_SPACEDIM,0);
+    amrex::Real rr0=rr;
+
+    //Normalise by the inertial scale so tol is a relative velocity tolerance
+    amrex::Real bnorm=MultiFab::Dot(*owner_mask,work,IMPL_X,work,IMPL_X,AMREX_SPACEDIM,0);
+    amrex::Real mmax=nodaldata.max(MASS_INDEX);
+    amrex::Real rtol2=tol*tol*amrex::max(rr0,mmax*mmax*bnorm);
+
+    int iter=0;
+    while(iter<maxiter && rr>rtol2 && rr>TINYVAL)
+    {
+        apply_operator(IMPL_P,IMPL_AP);
+        amrex::Real pAp=MultiFab::Dot(*owner_mask,work,IMPL_P,work,IMPL_AP,AMREX_SPACEDIM,0);
+        if(pAp<=zero)
+        {
+            amrex::Print()<<"\nImplicit solve: operator is not positive definite, stopping at iteration "<<iter;
+            break;
+        }
+        amrex::Real alpha=rr/pAp;
+
+        MultiFab::Saxpy(work,alpha,work,IMPL_P,IMPL_X,AMREX_SPACEDIM,0);
+        MultiFab::Saxpy(work,-alpha,work,IMPL_AP,IMPL_R,AMREX_SPACEDIM,0);
+
+        amrex::Real rr_new=MultiFab::Dot(*owner_mask,work,IMPL_R,work,IMPL_R,AMREX_SPACEDIM,0);
+        amrex::Real beta=rr_new/rr;
+        rr=rr_new;
+
+        //p = r + beta p
+        MultiFab::Xpay(work,beta,work,IMPL_R,IMPL_P,AMREX_SPACEDIM,0);
+        iter++;
+    }
+
+    if(iter==maxiter)
+    {
+        amrex::Print()<<"\nImplicit solve did not converge in "<<maxiter<<" iterations, residual ratio = "
+                      <<std::sqrt(rr/(rr0+TINYVAL));
+    }
+
+    MultiFab::Copy(nodaldata,work,IMPL_X,VELX_INDEX,AMREX_SPACEDIM,0);
+}
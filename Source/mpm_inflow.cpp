@@ -0,0 +1,260 @@
+#include <mpm_inflow.H>
+#include <mpm_particle_container.H>
+#include <constitutive_models.H>
+#include <constitutive_engine.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+#include <fstream>
+#include <sstream>
+
+using namespace amrex;
+
+void InflowSources::read(const std::string &a_ppname,const Geometry &geom)
+{
+    ppname=a_ppname;
+    ParmParse pp(ppname);
+
+    Vector<std::string> names;
+    pp.queryarr("names",names);
+    if(names.empty())
+    {
+        return;
+    }
+
+    const auto plo=geom.ProbLoArray();
+    const auto phi=geom.ProbHiArray();
+    const auto dx=geom.CellSizeArray();
+    dxmin=amrex::min(dx[XDIR],amrex::min(dx[YDIR],dx[ZDIR]));
+
+    for(int n=0;n<names.size();n++)
+    {
+        InflowSource src;
+        src.name=names[n];
+
+        const std::string prefix=ppname+"."+names[n];
+        ParmParse pps(prefix);
+
+        Vector<Real> vec;
+        pps.getarr("lo",vec,0,AMREX_SPACEDIM);
+        std::copy(vec.begin(),vec.end(),src.lo);
+        pps.getarr("hi",vec,0,AMREX_SPACEDIM);
+        std::copy(vec.begin(),vec.end(),src.hi);
+        if(pps.queryarr("velocity",vec,0,AMREX_SPACEDIM))
+        {
+            std::copy(vec.begin(),vec.end(),src.velocity);
+        }
+        pps.query("particles_per_cell",src.particles_per_cell);
+        pps.query("constitutive_model",src.constitutive_model);
+        pps.query("contact_field",src.contact_field);
+        pps.get("density",src.density);
+        pps.query("E",src.E);
+        pps.query("nu",src.nu);
+        pps.query("bulk_modulus",src.bulk_modulus);
+        pps.query("Gama_pressure",src.Gama_pressure);
+        pps.query("viscosity",src.viscosity);
+        pps.get("mass_flow_rate",src.mass_flow_rate);
+        pps.query("start_time",src.start_time);
+        pps.query("end_time",src.end_time);
+
+        if(src.particles_per_cell<1 || src.density<=zero || src.mass_flow_rate<=zero)
+        {
+            amrex::Abort("\n"+prefix+": particles_per_cell, density and mass_flow_rate should be positive");
+        }
+        if(src.contact_field<0 || src.contact_field>=MFC_MAX_FIELDS)
+        {
+            amrex::Abort("\n"+prefix+".contact_field is out of range");
+        }
+
+        //particle sites sit on the sub-cell lattice of the grid, a direction
+        //thinner than one spacing holds a single layer at its midplane
+        src.particle_volume=one;
+        Real fill_depth=zero;
+        Real vmag=std::sqrt(src.velocity[XDIR]*src.velocity[XDIR]
+                           +src.velocity[YDIR]*src.velocity[YDIR]
+                           +src.velocity[ZDIR]*src.velocity[ZDIR]);
+        Long nsites=1;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            Real h=dx[d]/src.particles_per_cell;
+            src.particle_volume*=h;
+            if(src.hi[d]-src.lo[d]<h)
+            {
+                Real x=half*(src.lo[d]+src.hi[d]);
+                if(x>=plo[d] && x<phi[d])
+                {
+                    src.sites[d].push_back(x);
+                }
+            }
+            else
+            {
+                int kmin=std::max(0,int(std::ceil((src.lo[d]-plo[d])/h-half)));
+                int kmax=int(std::floor((src.hi[d]-plo[d])/h-half));
+                for(int k=kmin;k<=kmax;k++)
+                {
+                    Real x=plo[d]+(k+half)*h;
+                    if(x<phi[d])
+                    {
+                        src.sites[d].push_back(x);
+                    }
+                }
+            }
+            nsites*=src.sites[d].size();
+            fill_depth+=amrex::Math::abs(src.velocity[d])/(vmag+TINYVAL)*src.sites[d].size()*h;
+        }
+        if(nsites==0)
+        {
+            amrex::Abort("\n"+prefix+" holds no particle sites inside the domain");
+        }
+        src.fill_mass=src.density*src.particle_volume*nsites;
+
+        //a fill has to move out of the source before the next one is placed
+        Real fill_interval=src.fill_mass/src.mass_flow_rate;
+        amrex::Print()<<"\n Inflow source "<<src.name<<": "<<nsites<<" particles of mass "
+                      <<src.fill_mass<<" every "<<fill_interval;
+        if(vmag*fill_interval<fill_depth*(one-TINYVAL))
+        {
+            amrex::Print()<<"\n Warning: inflow source "<<src.name<<" is fed faster than its material "
+                          <<"leaves the source, consecutive fills will overlap";
+        }
+
+        sources.push_back(src);
+    }
+    amrex::Print()<<"\n Inflow sources: "<<sources.size();
+}
+
+bool InflowSources::has_delta_form() const
+{
+    for(int n=0;n<sources.size();n++)
+    {
+        if(!constitutive_has_delta_form(sources[n].constitutive_model))
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+Real InflowSources::time_step(Real time,Real CFL,Real dtmax) const
+{
+    Real dt=dtmax;
+    for(int n=0;n<sources.size();n++)
+    {
+        const InflowSource& src=sources[n];
+        if(src.start_time<time+dtmax && src.end_time>time)
+        {
+            Real modulus=pwave_modulus(src.constitutive_model,src.E,src.nu,src.bulk_modulus);
+            dt=amrex::min(dt,CFL*cfl_timescale(modulus,src.density,src.velocity[XDIR],
+                                                src.velocity[YDIR],src.velocity[ZDIR],dxmin));
+        }
+    }
+    return(dt);
+}
+
+Long InflowSources::inject(MPMParticleContainer &mpm_pc,Real time,Real dt)
+{
+    BL_PROFILE("InflowSources::inject");
+    Long ncreated=0;
+    for(int n=0;n<sources.size();n++)
+    {
+        InflowSource& src=sources[n];
+        Real t0=std::max(time-dt,src.start_time);
+        Real t1=std::min(time,src.end_time);
+        if(t1<=t0)
+        {
+            continue;
+        }
+
+        //every rank keeps the same account, so no reduction is needed
+        src.mass_owed+=src.mass_flow_rate*(t1-t0);
+        if(src.mass_owed>=two*src.fill_mass && !src.warned_overlap)
+        {
+            amrex::Print()<<"\n Warning: inflow source "<<src.name<<" owes more than one fill in a step, "
+                          <<"the fills are placed on top of each other";
+            src.warned_overlap=true;
+        }
+        while(src.mass_owed>=src.fill_mass)
+        {
+            mpm_pc.add_inflow_particles(src);
+            src.mass_owed-=src.fill_mass;
+
+            Long nfill=src.sites[XDIR].size()*src.sites[YDIR].size()*src.sites[ZDIR].size();
+            src.injected_particles+=nfill;
+            src.injected_mass+=src.fill_mass;
+            ncreated+=nfill;
+        }
+    }
+    return(ncreated);
+}
+
+void InflowSources::record(DiagnosticsWriter &diagnostics,int nstep,Real time) const
+{
+    for(int n=0;n<sources.size();n++)
+    {
+        const std::string name="Inflow_"+sources[n].name;
+        if(diagnostics.due(name,nstep))
+        {
+            diagnostics.record(name,{"time","injected_particles","injected_mass","mass_owed"},
+                               {time,Real(sources[n].injected_particles),
+                                sources[n].injected_mass,sources[n].mass_owed});
+        }
+    }
+}
+
+void InflowSources::write_checkpoint(const std::string &chkname) const
+{
+    if(!active() || !ParallelDescriptor::IOProcessor())
+    {
+        return;
+    }
+    std::ofstream ofs(chkname+"/InflowSources");
+    if(!ofs.good())
+    {
+        amrex::FileOpenFailed(chkname+"/InflowSources");
+    }
+    ofs.precision(17);
+    ofs<<sources.size()<<"\n";
+    for(int n=0;n<sources.size();n++)
+    {
+        ofs<<sources[n].name<<" "<<sources[n].mass_owed<<" "
+           <<sources[n].injected_particles<<" "<<sources[n].injected_mass<<"\n";
+    }
+}
+
+void InflowSources::read_checkpoint(const std::string &chkname)
+{
+    if(!active())
+    {
+        return;
+    }
+    const std::string fname=chkname+"/InflowSources";
+    if(!amrex::FileExists(fname))
+    {
+        amrex::Print()<<"\n No inflow source state in "<<chkname<<", sources start empty";
+        return;
+    }
+
+    Vector<char> contents;
+    ParallelDescriptor::ReadAndBcastFile(fname,contents);
+    std::istringstream is(std::string(contents.dataPtr()));
+
+    int nsources=0;
+    is>>nsources;
+    for(int m=0;m<nsources;m++)
+    {
+        std::string name;
+        Real mass_owed,injected_mass;
+        Long injected_particles;
+        is>>name>>mass_owed>>injected_particles>>injected_mass;
+
+        //sources are matched by name, the geometry always comes from the inputs
+        for(int n=0;n<sources.size();n++)
+        {
+            if(sources[n].name==name)
+            {
+                sources[n].mass_owed=mass_owed;
+                sources[n].injected_particles=injected_particles;
+                sources[n].injected_mass=injected_mass;
+            }
+        }
+    }
+}
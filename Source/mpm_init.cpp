@@ -28,9 +28,7 @@ void MPMParticleContainer::InitParticles (const std::string& filename,
         const int lev  = 0;
         const int grid = 0;
         const int tile = 0;
-        const int tot_rig_body_tmp=10;
-        int rigid_bodies_read_so_far[tot_rig_body_tmp]={-1};
-        int index_rigid_body_read_so_far=0;
+        int max_rigid_body_id=-1;
 
         total_mass=0.0;														//Total mass of phase 0 material points
         total_vol=0.0;														//Total volume of phase 0 material points
@@ -56,20 +54,11 @@ void MPMParticleContainer::InitParticles (const std::string& filename,
             {
             	ifrigidnodespresent=1;
             	ifs >> p.idata(intData::rigid_body_id); 		//if there are multiple rigid bodies present, then tag them separately using this id. For the HPRO problem, rigid_body_id=0=> top jaw, rigid_body_id=1=>bottom jaw
-            	//Check if the rigid_body_id is not read before
-            	bool body_present=false;
-            	for(int j = 0;j<index_rigid_body_read_so_far;j++)
+            	if(p.idata(intData::rigid_body_id)<0)
             	{
-            		if(rigid_bodies_read_so_far[j]==p.idata(intData::rigid_body_id))
-            		{
-            			body_present=true;
-            		}
-            	}
-            	if(!body_present)
-            	{
-            		rigid_bodies_read_so_far[index_rigid_body_read_so_far]=p.idata(intData::rigid_body_id);
-            		index_rigid_body_read_so_far++;
+            		amrex::Abort("\n\tRigid body ids should start from 0. Please check your particle file");
             	}
+            	max_rigid_body_id=amrex::max(max_rigid_body_id,p.idata(intData::rigid_body_id));
             }
             else
             {
@@ -86,8 +75,13 @@ void MPMParticleContainer::InitParticles (const std::string& filename,
             ifs >> p.rdata(realData::yvel);
             ifs >> p.rdata(realData::zvel);
             ifs >> p.idata(intData::constitutive_model);		
+            p.idata(intData::dt_level)=0;
+            p.idata(intData::contact_field)=0;
+            p.idata(intData::quiet_steps)=0;
 
-            if(p.idata(intData::constitutive_model)==0)	//Elastic solid
+            p.rdata(realData::C01)=0.0;
+            if(p.idata(intData::constitutive_model)==0 or
+               p.idata(intData::constitutive_model)==2)	//Elastic solid, small strain or Neo-Hookean
             {
             	ifs >> p.rdata(realData::E);
             	ifs >> p.rdata(realData::nu);
@@ -103,6 +97,15 @@ void MPMParticleContainer::InitParticles (const std::string& filename,
             	ifs >> p.rdata(realData::Gama_pressure);
             	ifs >> p.rdata(realData::Dynamic_viscosity);
             }
+            else if(p.idata(intData::constitutive_model)==3)	//Mooney-Rivlin
+            {
+            	ifs >> p.rdata(realData::E);
+            	ifs >> p.rdata(realData::nu);
+            	ifs >> p.rdata(realData::C01);
+            	p.rdata(realData::Bulk_modulus)=0.0;
+            	p.rdata(realData::Gama_pressure)=0.0;
+            	p.rdata(realData::Dynamic_viscosity)=0.0;
+            }
             else
             {
             	amrex::Abort("\n\tIncorrect constitutive model. Please check your particle file");
@@ -150,7 +153,7 @@ void MPMParticleContainer::InitParticles (const std::string& filename,
             }
         }
         
-        num_of_rigid_bodies=index_rigid_body_read_so_far;
+        num_of_rigid_bodies=max_rigid_body_id+1;
         auto old_size = particle_tile.GetArrayOfStructs().size();
         auto new_size = old_size + host_particles.size();
         particle_tile.resize(new_size);
@@ -269,6 +272,73 @@ void MPMParticleContainer::InitParticles (Real mincoords[AMREX_SPACEDIM],Real ma
     Redistribute();
 }
 
+void MPMParticleContainer::add_inflow_particles(const InflowSource& src)
+{
+    BL_PROFILE("MPMParticleContainer::add_inflow_particles");
+    int lev = 0;
+    const auto plo = Geom(lev).ProbLoArray();
+    const auto dxi = Geom(lev).InvCellSizeArray();
+    Real vel[AMREX_SPACEDIM]={src.velocity[XDIR],src.velocity[YDIR],src.velocity[ZDIR]};
+
+    //neighbour copies sit at the end of each tile, new particles must not
+    //land behind them; the caller rebuilds the neighbours afterwards
+    clearNeighbors();
+
+    for (MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        const Box& tile_box = mfi.tilebox();
+
+        //source sites whose cell lies in this tile
+        Vector<Real> tile_sites[AMREX_SPACEDIM];
+        bool empty=false;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            for(Real x : src.sites[d])
+            {
+                int c=static_cast<int>(amrex::Math::floor((x-plo[d])*dxi[d]));
+                if(c>=tile_box.smallEnd(d) && c<=tile_box.bigEnd(d))
+                {
+                    tile_sites[d].push_back(x);
+                }
+            }
+            empty=empty || tile_sites[d].empty();
+        }
+        if(empty)
+        {
+            continue;
+        }
+
+        const int grid_id = mfi.index();
+        const int tile_id = mfi.LocalTileIndex();
+        auto& particle_tile = GetParticles(lev)[std::make_pair(grid_id, tile_id)];
+
+        Gpu::HostVector<ParticleType> host_particles;
+        for(Real z : tile_sites[ZDIR])
+        {
+            for(Real y : tile_sites[YDIR])
+            {
+                for(Real x : tile_sites[XDIR])
+                {
+                    ParticleType p = generate_particle(x,y,z,vel,
+                                     src.density,src.particle_volume,src.constitutive_model,
+                                     src.E,src.nu,src.bulk_modulus,src.Gama_pressure,src.viscosity);
+                    p.idata(intData::contact_field)=src.contact_field;
+                    host_particles.push_back(p);
+                }
+            }
+        }
+
+        auto old_size = particle_tile.GetArrayOfStructs().size();
+        auto new_size = old_size + host_particles.size();
+        particle_tile.resize(new_size);
+
+        Gpu::copy(Gpu::hostToDevice,
+                  host_particles.begin(),
+                  host_particles.end(),
+                  particle_tile.GetArrayOfStructs().begin() + old_size);
+    }
+}
+
 MPMParticleContainer::ParticleType MPMParticleContainer::generate_particle
         (Real x,Real y,Real z,
         Real vel[AMREX_SPACEDIM],
@@ -292,18 +362,30 @@ MPMParticleContainer::ParticleType MPMParticleContainer::generate_particle
     p.rdata(realData::zvel) = vel[ZDIR];
 
     p.idata(intData::constitutive_model)=constmodel;
+    p.idata(intData::dt_level)=0;
+    p.idata(intData::contact_field)=0;
+    p.idata(intData::quiet_steps)=0;
 
     p.rdata(realData::E)=E;
     p.rdata(realData::nu)=nu;
     p.rdata(realData::Bulk_modulus)=bulkmod;
     p.rdata(realData::Gama_pressure)=Gama_pres;
     p.rdata(realData::Dynamic_viscosity)=visc;
+    p.rdata(realData::C01)=0.0;
 
     p.rdata(realData::volume)=vol;	
     p.rdata(realData::mass)=dens*vol;
     p.rdata(realData::jacobian)=1.0;
     p.rdata(realData::pressure)=0.0;
-    p.rdata(realData::vol_init)=0.0;
+    p.rdata(realData::vol_init)=vol;
+
+    for(int comp=0;comp<NCOMP_FULLTENSOR;comp++)
+    {
+        p.rdata(realData::deformation_gradient+comp) = 0.0;
+    }
+    p.rdata(realData::deformation_gradient+0) = 1.0;
+    p.rdata(realData::deformation_gradient+4) = 1.0;
+    p.rdata(realData::deformation_gradient+8) = 1.0;
     
     for(int comp=0;comp<NCOMP_TENSOR;comp++)
     {
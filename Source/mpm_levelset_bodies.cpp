@@ -0,0 +1,404 @@
+#include <mpm_levelset_bodies.H>
+#include <mpm_eb.H>
+#include <mpm_kernels.H>
+#include <nodal_data_ops.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+#include <fstream>
+#include <sstream>
+
+using namespace amrex;
+
+void LevelsetBodies::read(const std::string &a_ppname)
+{
+    ppname=a_ppname;
+    ParmParse pp(ppname);
+
+    Vector<std::string> names;
+    pp.queryarr("names",names);
+    if(names.empty())
+    {
+        return;
+    }
+    pp.query("contact_band_cells",contact_band_cells);
+
+    for(int b=0;b<names.size();b++)
+    {
+        LevelsetBody body;
+        LevelsetBodyMotion mot;
+        mot.name=names[b];
+
+        const std::string prefix=ppname+"."+names[b];
+        ParmParse ppb(prefix);
+
+        //object coordinates are relative to the body origin
+        body.shape=mpm_ebtools::read_csg_objects(prefix);
+        mot.bounded=body.shape.bounding_box(mot.bblo,mot.bbhi);
+
+        Vector<Real> vec;
+        if(ppb.queryarr("position",vec,0,AMREX_SPACEDIM))
+        {
+            std::copy(vec.begin(),vec.end(),body.pos);
+        }
+        if(ppb.queryarr("velocity",vec,0,AMREX_SPACEDIM))
+        {
+            std::copy(vec.begin(),vec.end(),mot.imposed_velocity);
+            std::copy(vec.begin(),vec.end(),body.vel);
+        }
+        if(ppb.queryarr("angular_velocity",vec,0,AMREX_SPACEDIM))
+        {
+            std::copy(vec.begin(),vec.end(),body.omega);
+        }
+        ppb.query("position_update_method",mot.position_update_method);
+        ppb.query("enable_weight",mot.enable_weight);
+        ppb.query("contact_bc",body.contact_bc);
+        ppb.query("wall_mu",body.wall_mu);
+        if(mot.position_update_method==1)
+        {
+            ppb.get("mass",mot.mass);
+            if(mot.mass<=zero)
+            {
+                amrex::Abort("\n"+prefix+".mass should be positive");
+            }
+            //body-frame inertia about the body origin, taken as the centre
+            //of mass: Ixx Iyy Izz Ixy Iyz Ixz
+            if(ppb.queryarr("inertia",vec,0,6))
+            {
+                mot.rotational=true;
+                mot.inertia[XDIR][XDIR]=vec[0];
+                mot.inertia[YDIR][YDIR]=vec[1];
+                mot.inertia[ZDIR][ZDIR]=vec[2];
+                mot.inertia[XDIR][YDIR]=mot.inertia[YDIR][XDIR]=vec[3];
+                mot.inertia[YDIR][ZDIR]=mot.inertia[ZDIR][YDIR]=vec[4];
+                mot.inertia[XDIR][ZDIR]=mot.inertia[ZDIR][XDIR]=vec[5];
+                Real omega_test[AMREX_SPACEDIM]={zero,zero,zero};
+                if(vec[0]<=zero || vec[1]<=zero || vec[2]<=zero ||
+                   !solve33(mot.inertia,omega_test,omega_test))
+                {
+                    amrex::Abort("\n"+prefix+".inertia should be positive definite");
+                }
+            }
+        }
+        else if(mot.position_update_method!=0)
+        {
+            amrex::Abort("\n"+prefix+".position_update_method should be 0 (imposed) or 1 (dynamics)");
+        }
+
+        bodies.push_back(body);
+        motion.push_back(mot);
+    }
+    amrex::Print()<<"\n Level-set rigid bodies: "<<bodies.size();
+}
+
+//Node index box that can hold contact nodes of body b, the whole domain
+//when the shape is unbounded
+Box LevelsetBodies::contact_region(int b,const Geometry &geom,Real band) const
+{
+    Box region=amrex::convert(geom.Domain(),IntVect::TheNodeVector());
+    const LevelsetBodyMotion& mot=motion[b];
+    if(!mot.bounded)
+    {
+        return(region);
+    }
+
+    const LevelsetBody& body=bodies[b];
+    const auto plo=geom.ProbLoArray();
+    const auto dxi=geom.InvCellSizeArray();
+
+    Real wlo[AMREX_SPACEDIM]={BIGVAL,BIGVAL,BIGVAL};
+    Real whi[AMREX_SPACEDIM]={-BIGVAL,-BIGVAL,-BIGVAL};
+    for(int c=0;c<8;c++)
+    {
+        Real xb[AMREX_SPACEDIM]={(c&1)?mot.bbhi[XDIR]:mot.bblo[XDIR],
+                                 (c&2)?mot.bbhi[YDIR]:mot.bblo[YDIR],
+                                 (c&4)?mot.bbhi[ZDIR]:mot.bblo[ZDIR]};
+        for(int a=0;a<AMREX_SPACEDIM;a++)
+        {
+            Real xw=body.pos[a];
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                xw+=body.rot[a][d]*xb[d];
+            }
+            wlo[a]=amrex::min(wlo[a],xw-band);
+            whi[a]=amrex::max(whi[a],xw+band);
+        }
+    }
+
+    IntVect lo,hi;
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        lo[d]=static_cast<int>(std::floor((wlo[d]-plo[d])*dxi[d]));
+        hi[d]=static_cast<int>(std::ceil((whi[d]-plo[d])*dxi[d]));
+    }
+    return(region & Box(lo,hi,IntVect::TheNodeVector()));
+}
+
+Real LevelsetBodies::contact_band(const Geometry &geom) const
+{
+    const auto dx=geom.CellSizeArray();
+    return(contact_band_cells*amrex::min(dx[XDIR],amrex::min(dx[YDIR],dx[ZDIR])));
+}
+
+void LevelsetBodies::apply_contact(MultiFab &nodaldata,const Geometry &geom,
+                                   Real mass_tolerance,Real dt,bool record_force)
+{
+    BL_PROFILE("LevelsetBodies::apply_contact");
+
+    const auto plo=geom.ProbLoArray();
+    const auto dx=geom.CellSizeArray();
+    const Real dxmin=amrex::min(dx[XDIR],amrex::min(dx[YDIR],dx[ZDIR]));
+    const Real band=contact_band(geom);
+    const Real hgrad=0.01*dxmin;
+
+    //shared nodes on box faces are counted once
+    const IntVect domhi=geom.Domain().bigEnd();
+    const IntVect nonperiodic(AMREX_D_DECL(!geom.isPeriodic(XDIR),!geom.isPeriodic(YDIR),!geom.isPeriodic(ZDIR)));
+
+    for(int b=0;b<bodies.size();b++)
+    {
+        const LevelsetBody body=bodies[b];
+        const Box region=contact_region(b,geom,band);
+
+        ReduceOps<ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum> reduce_op;
+        ReduceData<Real,Real,Real,Real,Real,Real> reduce_data(reduce_op);
+        using ReduceTuple = typename decltype(reduce_data)::Type;
+
+        for(MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+        {
+            const Box& bx=mfi.validbox();
+            const Box nodalbox=convert(bx,{1,1,1}) & region;
+            if(!nodalbox.ok())
+            {
+                continue;
+            }
+            const IntVect bxhi=bx.bigEnd();
+
+            Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+
+            reduce_op.eval(nodalbox,reduce_data,[=]
+            AMREX_GPU_DEVICE (int i,int j,int k) -> ReduceTuple
+            {
+                if(nodal_data_arr(i,j,k,MASS_INDEX)<=mass_tolerance)
+                {
+                    return {zero,zero,zero,zero,zero,zero};
+                }
+
+                Real xn[AMREX_SPACEDIM]={plo[XDIR]+i*dx[XDIR],plo[YDIR]+j*dx[YDIR],plo[ZDIR]+k*dx[ZDIR]};
+                if(body.value(xn)<=-band)
+                {
+                    return {zero,zero,zero,zero,zero,zero};
+                }
+
+                Real normaldir[AMREX_SPACEDIM];
+                body.normal(xn,hgrad,normaldir);
+                Real vbody[AMREX_SPACEDIM];
+                body.velocity_at(xn,vbody);
+
+                Real relvel_in[AMREX_SPACEDIM];
+                Real relvel_out[AMREX_SPACEDIM];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    relvel_in[d]=nodal_data_arr(i,j,k,VELX_INDEX+d)-vbody[d];
+                    relvel_out[d]=relvel_in[d];
+                }
+                applybc(relvel_in,relvel_out,body.wall_mu,normaldir,body.contact_bc);
+
+                //momentum taken out of the node is the load on the body
+                Real frc[AMREX_SPACEDIM];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    nodal_data_arr(i,j,k,VELX_INDEX+d)=relvel_out[d]+vbody[d];
+                    frc[d]=-nodal_data_arr(i,j,k,MASS_INDEX)*(relvel_out[d]-relvel_in[d])/dt;
+                }
+
+                if(!nodal_owned(IntVect(i,j,k),bxhi,domhi,nonperiodic))
+                {
+                    return {zero,zero,zero,zero,zero,zero};
+                }
+                Real r[AMREX_SPACEDIM]={xn[XDIR]-body.pos[XDIR],xn[YDIR]-body.pos[YDIR],xn[ZDIR]-body.pos[ZDIR]};
+                return {frc[XDIR],frc[YDIR],frc[ZDIR],
+                        r[YDIR]*frc[ZDIR]-r[ZDIR]*frc[YDIR],
+                        r[ZDIR]*frc[XDIR]-r[XDIR]*frc[ZDIR],
+                        r[XDIR]*frc[YDIR]-r[YDIR]*frc[XDIR]};
+            });
+        }
+
+        if(record_force)
+        {
+            ReduceTuple hv=reduce_data.value(reduce_op);
+            Real load[2*AMREX_SPACEDIM]={amrex::get<0>(hv),amrex::get<1>(hv),amrex::get<2>(hv),
+                                         amrex::get<3>(hv),amrex::get<4>(hv),amrex::get<5>(hv)};
+#ifdef BL_USE_MPI
+            ParallelDescriptor::ReduceRealSum(load,2*AMREX_SPACEDIM);
+#endif
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                motion[b].force[d]=load[d];
+                motion[b].torque[d]=load[AMREX_SPACEDIM+d];
+            }
+        }
+    }
+}
+
+void LevelsetBodies::advance(Real dt,const Real gravity[AMREX_SPACEDIM])
+{
+    for(int b=0;b<bodies.size();b++)
+    {
+        LevelsetBody& body=bodies[b];
+        const LevelsetBodyMotion& mot=motion[b];
+
+        if(mot.position_update_method==1)
+        {
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                Real fext=(mot.enable_weight)?mot.mass*gravity[d]:zero;
+                body.vel[d]+=(mot.force[d]+fext)/mot.mass*dt;
+            }
+            if(mot.rotational)
+            {
+                angular_velocity_update(mot.inertia,body.rot,mot.torque,dt,body.omega);
+            }
+        }
+        else
+        {
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                body.vel[d]=mot.imposed_velocity[d];
+            }
+        }
+
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            body.pos[d]+=body.vel[d]*dt;
+        }
+        Real dR[AMREX_SPACEDIM][AMREX_SPACEDIM],rnew[AMREX_SPACEDIM][AMREX_SPACEDIM];
+        rotation_increment(body.omega,dt,dR);
+        matmul33(dR,body.rot,rnew);
+        std::copy(&rnew[0][0],&rnew[0][0]+AMREX_SPACEDIM*AMREX_SPACEDIM,&body.rot[0][0]);
+    }
+}
+
+void LevelsetBodies::record(DiagnosticsWriter &diagnostics,int nstep,Real time) const
+{
+    for(int b=0;b<bodies.size();b++)
+    {
+        const std::string name="Body_"+motion[b].name;
+        if(diagnostics.due(name,nstep))
+        {
+            const LevelsetBody& body=bodies[b];
+            const LevelsetBodyMotion& mot=motion[b];
+            diagnostics.record(name,{"time","x","y","z","vx","vy","vz","fx","fy","fz"},
+                               {time,body.pos[XDIR],body.pos[YDIR],body.pos[ZDIR],
+                                body.vel[XDIR],body.vel[YDIR],body.vel[ZDIR],
+                                mot.force[XDIR],mot.force[YDIR],mot.force[ZDIR]});
+        }
+    }
+}
+
+void LevelsetBodies::write_checkpoint(const std::string &chkname) const
+{
+    if(!active() || !ParallelDescriptor::IOProcessor())
+    {
+        return;
+    }
+    std::ofstream ofs(chkname+"/LevelsetBodies");
+    if(!ofs.good())
+    {
+        amrex::FileOpenFailed(chkname+"/LevelsetBodies");
+    }
+    ofs.precision(17);
+    ofs<<bodies.size()<<"\n";
+    for(int b=0;b<bodies.size();b++)
+    {
+        const LevelsetBody& body=bodies[b];
+        ofs<<motion[b].name;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            ofs<<" "<<body.pos[d];
+        }
+        for(int a=0;a<AMREX_SPACEDIM;a++)
+        {
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                ofs<<" "<<body.rot[a][d];
+            }
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            ofs<<" "<<body.vel[d];
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            ofs<<" "<<body.omega[d];
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            ofs<<" "<<motion[b].force[d];
+        }
+        ofs<<"\n";
+    }
+}
+
+void LevelsetBodies::read_checkpoint(const std::string &chkname)
+{
+    if(!active())
+    {
+        return;
+    }
+    const std::string fname=chkname+"/LevelsetBodies";
+    if(!amrex::FileExists(fname))
+    {
+        amrex::Print()<<"\n No level-set body state in "<<chkname<<", bodies start from the inputs";
+        return;
+    }
+
+    Vector<char> contents;
+    ParallelDescriptor::ReadAndBcastFile(fname,contents);
+    std::istringstream is(std::string(contents.dataPtr()));
+
+    int nbodies=0;
+    is>>nbodies;
+    for(int n=0;n<nbodies;n++)
+    {
+        std::string name;
+        LevelsetBody state;
+        Real force[AMREX_SPACEDIM];
+        is>>name;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            is>>state.pos[d];
+        }
+        for(int a=0;a<AMREX_SPACEDIM;a++)
+        {
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                is>>state.rot[a][d];
+            }
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            is>>state.vel[d];
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            is>>state.omega[d];
+        }
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            is>>force[d];
+        }
+
+        //bodies are matched by name, the shape always comes from the inputs
+        for(int b=0;b<bodies.size();b++)
+        {
+            if(motion[b].name==name)
+            {
+                std::copy(state.pos,state.pos+AMREX_SPACEDIM,bodies[b].pos);
+                std::copy(&state.rot[0][0],&state.rot[0][0]+AMREX_SPACEDIM*AMREX_SPACEDIM,&bodies[b].rot[0][0]);
+                std::copy(state.vel,state.vel+AMREX_SPACEDIM,bodies[b].vel);
+                std::copy(state.omega,state.omega+AMREX_SPACEDIM,bodies[b].omega);
+                std::copy(force,force+AMREX_SPACEDIM,motion[b].force);
+            }
+        }
+    }
+}
@@ -0,0 +1,457 @@
+#include <mpm_particle_container.H>
+#include <interpolants.H>
+#include <mpm_kernels.H>
+#include <nodal_data_ops.H>
+#include <mpm_levelset_bodies.H>
+#include <rigid_motion.H>
+#include <AMReX_Scan.H>
+
+using namespace amrex;
+
+void MPMParticleContainer::assign_contact_fields(const amrex::Vector<amrex::Real>& boxes)
+{
+    BL_PROFILE("MPMParticleContainer::assign_contact_fields");
+
+    const int lev = 0;
+    auto& plev  = GetParticles(lev);
+    const int nboxes=boxes.size()/(2*AMREX_SPACEDIM);
+
+    Gpu::DeviceVector<Real> boxes_d(boxes.size());
+    Gpu::copy(Gpu::hostToDevice,boxes.begin(),boxes.end(),boxes_d.begin());
+    const Real* bptr=boxes_d.data();
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            ParticleType& p = pstruct[i];
+            int field=0;
+            for(int b=0;b<nboxes;b++)
+            {
+                const Real* lo=bptr+2*AMREX_SPACEDIM*b;
+                const Real* hi=lo+AMREX_SPACEDIM;
+                if(p.pos(XDIR)>=lo[XDIR] && p.pos(XDIR)<=hi[XDIR] &&
+                   p.pos(YDIR)>=lo[YDIR] && p.pos(YDIR)<=hi[YDIR] &&
+                   p.pos(ZDIR)>=lo[ZDIR] && p.pos(ZDIR)<=hi[ZDIR])
+                {
+                    field=b+1;
+                }
+            }
+            p.idata(intData::contact_field)=(p.idata(intData::phase)==0)?field:0;
+        });
+    }
+    Gpu::streamSynchronize();
+}
+
+ContactFieldView MPMParticleContainer::contact_field_view(const std::pair<int,int>& index) const
+{
+    ContactFieldView view;
+    if(!mfc_active)
+    {
+        return(view);
+    }
+    auto it=mfc_tiles.find(index);
+    if(it==mfc_tiles.end() || it->second.nslots==0)
+    {
+        return(view);
+    }
+    view.mask=it->second.mask.const_array();
+    view.offset=it->second.offset.const_array();
+    view.slots=it->second.slots.data();
+    view.nslots=it->second.nslots;
+    view.mass_tolerance=mfc_mass_tolerance;
+    return(view);
+}
+
+void MPMParticleContainer::multifield_contact(MultiFab& nodaldata,
+                                              Array<Real,AMREX_SPACEDIM> gravity,
+                                              int external_loads_present,
+                                              Array<Real,AMREX_SPACEDIM> force_slab_lo,
+                                              Array<Real,AMREX_SPACEDIM> force_slab_hi,
+                                              Array<Real,AMREX_SPACEDIM> extforce,
+                                              int update_forces,
+                                              const amrex::Real& dt,
+                                              amrex::Real contact_mu,
+                                              amrex::Real mass_tolerance,
+                                              GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
+                                              GpuArray<int,AMREX_SPACEDIM> periodic,
+                                              int bclo[AMREX_SPACEDIM],int bchi[AMREX_SPACEDIM],
+                                              int lsetbc,
+                                              amrex::Real wall_mu_lo[AMREX_SPACEDIM],
+                                              amrex::Real wall_mu_hi[AMREX_SPACEDIM],
+                                              amrex::Real wall_vel_lo[AMREX_SPACEDIM*AMREX_SPACEDIM],
+                                              amrex::Real wall_vel_hi[AMREX_SPACEDIM*AMREX_SPACEDIM],
+                                              amrex::Real lset_wall_mu,
+                                              const MultiFab* rigiddata,
+                                              const Gpu::DeviceVector<amrex::Real>& rigid_motion,
+                                              const LevelsetBodies& lsbodies)
+{
+    BL_PROFILE("MPMParticleContainer::multifield_contact");
+
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    auto& plev  = GetParticles(lev);
+    const auto dxi = geom.InvCellSizeArray();
+    const auto dx = geom.CellSizeArray();
+    const auto plo = geom.ProbLoArray();
+    const auto domain = geom.Domain();
+    const IntVect domlo=domain.smallEnd();
+    const IntVect domhi=domain.bigEnd();
+    int extloads=external_loads_present;
+
+    Real grav[]={AMREX_D_DECL(gravity[XDIR],gravity[YDIR],gravity[ZDIR])};
+    Real slab_lo[]={AMREX_D_DECL(force_slab_lo[XDIR],force_slab_lo[YDIR],force_slab_lo[ZDIR])};
+    Real slab_hi[]={AMREX_D_DECL(force_slab_hi[XDIR],force_slab_hi[YDIR],force_slab_hi[ZDIR])};
+    Real extpforce[]={AMREX_D_DECL(extforce[XDIR],extforce[YDIR],extforce[ZDIR])};
+
+    const int* loarr = domain.loVect ();
+    const int* hiarr = domain.hiVect ();
+
+    int lo[]={loarr[0],loarr[1],loarr[2]};
+    int hi[]={hiarr[0],hiarr[1],hiarr[2]};
+
+    //walls and rigid bodies act on every body's velocity as they acted on
+    //the common nodal velocity
+    ParticleWallBC wallbc=make_particle_wall_bc(geom,bclo,bchi,lsetbc,wall_mu_lo,wall_mu_hi,
+                                                wall_vel_lo,wall_vel_hi,lset_wall_mu);
+    const int nrigid=(rigiddata!=nullptr)?rigid_motion.size()/RIGID_MOTION_COMPS:0;
+    const amrex::Real* motionptr=rigid_motion.dataPtr();
+
+    const int nlsbodies=lsbodies.size();
+    Gpu::DeviceVector<LevelsetBody> lsbodies_d(nlsbodies);
+    if(nlsbodies>0)
+    {
+        Gpu::copy(Gpu::hostToDevice,lsbodies.shapes().begin(),lsbodies.shapes().end(),lsbodies_d.begin());
+    }
+    const LevelsetBody* lsbodyptr=lsbodies_d.dataPtr();
+    const Real lsband=(nlsbodies>0)?lsbodies.contact_band(geom):zero;
+    const Real hgrad=0.01*amrex::min(dx[XDIR],amrex::min(dx[YDIR],dx[ZDIR]));
+
+    mfc_active=true;
+    mfc_mass_tolerance=mass_tolerance;
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        int np = aos.numRealParticles();
+        int ng =aos.numNeighborParticles();
+        int nt = np+ng;
+
+        ParticleType* pstruct = aos().dataPtr();
+
+        //1. the bodies present at each node come with the mass deposition
+        ContactFieldTile& cft=mfc_tiles[index];
+        cft.nslots=0;
+        if(!cft.mask.box().ok())
+        {
+            continue;
+        }
+        const Box region=cft.mask.box();
+        cft.offset.resize(region,1);
+        Array4<int> mask_arr=cft.mask.array();
+        Array4<int> offset_arr=cft.offset.array();
+
+        ParticleWallBC tilebc=wallbc;
+        tilebc.using_levsets=(wallbc.using_levsets && mpm_ebtools::near_eb(mfi));
+        amrex::Array4<amrex::Real> lsetarr;
+        if(tilebc.using_levsets)
+        {
+            lsetarr=mpm_ebtools::lsphi->array(mfi);
+        }
+        Array4<Real const> rigid_arr=(nrigid>0)?rigiddata->const_array(mfi):Array4<Real const>();
+
+        //2. nodes with more than one body are packed, then each gets a run
+        //of slots, one per body present
+        const int npts=region.numPts();
+        cft.nodes.resize(npts);
+        int* nodeptr=cft.nodes.data();
+        const int nnodes=Scan::PrefixSum<int>(npts,
+        [=] AMREX_GPU_DEVICE (int n) -> int
+        {
+            return(contact_field_count(mask_arr(region.atOffset(n)))>1);
+        },
+        [=] AMREX_GPU_DEVICE (int n, int const& x)
+        {
+            if(contact_field_count(mask_arr(region.atOffset(n)))>1)
+            {
+                nodeptr[x]=n;
+            }
+        },
+        Scan::Type::exclusive, Scan::retSum);
+        cft.nodes.resize(nnodes);
+        if(nnodes==0)
+        {
+            continue;
+        }
+        nodeptr=cft.nodes.data();
+
+        cft.nslots=Scan::PrefixSum<int>(nnodes,
+        [=] AMREX_GPU_DEVICE (int n) -> int
+        {
+            return(contact_field_count(mask_arr(region.atOffset(nodeptr[n]))));
+        },
+        [=] AMREX_GPU_DEVICE (int n, int const& x)
+        {
+            offset_arr(region.atOffset(nodeptr[n]))=x;
+        },
+        Scan::Type::exclusive, Scan::retSum);
+
+        const int nslots=cft.nslots;
+        cft.slots.resize(MFC_NCOMP*nslots);
+        Real* slots=cft.slots.data();
+        amrex::ParallelFor(MFC_NCOMP*nslots,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            slots[i]=zero;
+        });
+
+        //3. per-body mass, momentum, force and mass gradient at those nodes
+        amrex::ParallelFor(nt,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            int lmin,lmax,nmin,nmax,mmin,mmax;
+            ParticleType& p = pstruct[i];
+            if(p.idata(intData::phase)!=0 || p.id()<0)
+            {
+                return;
+            }
+
+            amrex::Real xp[AMREX_SPACEDIM];
+            xp[XDIR]=p.pos(XDIR);
+            xp[YDIR]=p.pos(YDIR);
+            xp[ZDIR]=p.pos(ZDIR);
+
+            auto iv = getParticleCell(p, plo, dxi, domain);
+
+            lmin=(order_scheme_directional[0]==1)?0:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?0:((iv[XDIR]==hi[XDIR])?-1:-1):-1000);
+            lmax=(order_scheme_directional[0]==1)?2:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?lmin+3:((iv[XDIR]==hi[XDIR])?lmin+3:lmin+4):-1000);
+
+            mmin=(order_scheme_directional[1]==1)?0:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?0:((iv[YDIR]==hi[YDIR])?-1:-1):-1000);
+            mmax=(order_scheme_directional[1]==1)?2:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?mmin+3:((iv[YDIR]==hi[YDIR])?mmin+3:mmin+4):-1000);
+
+            nmin=(order_scheme_directional[2]==1)?0:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?0:((iv[ZDIR]==hi[ZDIR])?-1:-1):-1000);
+            nmax=(order_scheme_directional[2]==1)?2:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?nmin+3:((iv[ZDIR]==hi[ZDIR])?nmin+3:nmin+4):-1000);
+
+            const int field=p.idata(intData::contact_field);
+            amrex::Real stress_tens[AMREX_SPACEDIM*AMREX_SPACEDIM];
+            if(update_forces)
+            {
+                get_tensor(p,realData::stress,stress_tens);
+            }
+            const bool loaded=(extloads &&
+                               xp[XDIR]>slab_lo[XDIR] && xp[XDIR]<slab_hi[XDIR] &&
+                               xp[YDIR]>slab_lo[YDIR] && xp[YDIR]<slab_hi[YDIR] &&
+                               xp[ZDIR]>slab_lo[ZDIR] && xp[ZDIR]<slab_hi[ZDIR]);
+
+            for(int n=nmin;n<nmax;n++)
+            {
+                for(int m=mmin;m<mmax;m++)
+                {
+                    for(int l=lmin;l<lmax;l++)
+                    {
+                        IntVect ivlocal(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n);
+                        if(!region.contains(ivlocal))
+                        {
+                            continue;
+                        }
+                        int bits=mask_arr(ivlocal);
+                        if(contact_field_count(bits)<2)
+                        {
+                            continue;
+                        }
+                        const int s=offset_arr(ivlocal)+contact_field_rank(bits,field);
+
+                        amrex::Real basisvalue=basisval(l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                        amrex::Real basisval_grad[AMREX_SPACEDIM];
+                        for(int d=0;d<AMREX_SPACEDIM;d++)
+                        {
+                            basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                        }
+
+                        const amrex::Real mp=p.rdata(realData::mass);
+                        const amrex::Real vp[AMREX_SPACEDIM]={p.rdata(realData::xvel),p.rdata(realData::yvel),p.rdata(realData::zvel)};
+                        amrex::Gpu::Atomic::AddNoRet(&slots[MFC_MASS*nslots+s],mp*basisvalue);
+                        for(int d=0;d<AMREX_SPACEDIM;d++)
+                        {
+                            amrex::Gpu::Atomic::AddNoRet(&slots[(MFC_MOMX+d)*nslots+s],mp*vp[d]*basisvalue);
+                            amrex::Gpu::Atomic::AddNoRet(&slots[(MFC_GRADX+d)*nslots+s],mp*basisval_grad[d]);
+                        }
+
+                        if(update_forces)
+                        {
+                            amrex::Real tensvect[AMREX_SPACEDIM];
+                            tensor_vector_pdt(stress_tens,basisval_grad,tensvect);
+                            for(int d=0;d<AMREX_SPACEDIM;d++)
+                            {
+                                amrex::Real frc=mp*grav[d]*basisvalue-p.rdata(realData::volume)*tensvect[d];
+                                if(loaded)
+                                {
+                                    frc+=extpforce[d]*basisvalue;
+                                }
+                                amrex::Gpu::Atomic::AddNoRet(&slots[(MFC_FRCX+d)*nslots+s],frc);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        //4. fused correction over the shared nodes: each body's trial velocity
+        //is compared with the centre-of-mass velocity, approaching normal
+        //components are removed and the tangential ones limited by Coulomb
+        //friction. The rigid bodies, walls and level-set bodies then act on
+        //every body's velocity in the order they act on the common one.
+        amrex::ParallelFor(nnodes,[=]
+        AMREX_GPU_DEVICE (int node) noexcept
+        {
+            const IntVect nodeid=region.atOffset(nodeptr[node]);
+            const int bits=mask_arr(nodeid);
+            const int nf=contact_field_count(bits);
+            const int s0=offset_arr(nodeid);
+
+            amrex::Real M=zero;
+            amrex::Real P[AMREX_SPACEDIM]={zero,zero,zero};
+            amrex::Real G[AMREX_SPACEDIM]={zero,zero,zero};
+            for(int r=0;r<nf;r++)
+            {
+                const int s=s0+r;
+                M+=slots[MFC_MASS*nslots+s];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    P[d]+=slots[(MFC_MOMX+d)*nslots+s]+slots[(MFC_FRCX+d)*nslots+s]*dt;
+                    G[d]+=slots[(MFC_GRADX+d)*nslots+s];
+                }
+            }
+            if(M<mass_tolerance)
+            {
+                for(int r=0;r<nf;r++)
+                {
+                    slots[MFC_MASS*nslots+s0+r]=zero;
+                }
+                return;
+            }
+
+            amrex::Real vcm[AMREX_SPACEDIM];
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                vcm[d]=P[d]/M;
+            }
+            amrex::Real xn[AMREX_SPACEDIM]={plo[XDIR]+nodeid[XDIR]*dx[XDIR],
+                                           plo[YDIR]+nodeid[YDIR]*dx[YDIR],
+                                           plo[ZDIR]+nodeid[ZDIR]*dx[ZDIR]};
+
+            //rigid material points in contact at this node, as in nodal_detect_contact
+            int rb=-1;
+            if(nrigid>0 && rigid_arr.contains(nodeid[XDIR],nodeid[YDIR],nodeid[ZDIR]) &&
+               rigid_arr(nodeid,MASS_RIGID_INDEX)>mass_tolerance)
+            {
+                rb=int(rigid_arr(nodeid,RIGID_BODY_ID));
+                rb=(rb>=0 && rb<nrigid)?rb:-1;
+            }
+
+            for(int r=0;r<nf;r++)
+            {
+                const int s=s0+r;
+                const amrex::Real mf=slots[MFC_MASS*nslots+s];
+                if(mf<mass_tolerance)
+                {
+                    slots[MFC_MASS*nslots+s]=zero;
+                    continue;
+                }
+
+                //normal into this body, from its own mass gradient against the rest
+                amrex::Real normaldir[AMREX_SPACEDIM];
+                amrex::Real nmag=zero;
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    normaldir[d]=two*slots[(MFC_GRADX+d)*nslots+s]-G[d];
+                    nmag+=normaldir[d]*normaldir[d];
+                }
+                nmag=std::sqrt(nmag);
+
+                amrex::Real relvel_in[AMREX_SPACEDIM],relvel_out[AMREX_SPACEDIM];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    normaldir[d]=normaldir[d]/(nmag+TINYVAL);
+                    relvel_in[d]=(slots[(MFC_MOMX+d)*nslots+s]+slots[(MFC_FRCX+d)*nslots+s]*dt)/mf-vcm[d];
+                    relvel_out[d]=relvel_in[d];
+                }
+                if(nmag>TINYVAL)
+                {
+                    applybc(relvel_in,relvel_out,contact_mu,normaldir,BC_PARTIALSLIPWALL);
+                }
+
+                amrex::Real vnew[AMREX_SPACEDIM];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    vnew[d]=vcm[d]+relvel_out[d];
+                }
+
+                if(rb>=0)
+                {
+                    amrex::Real vbody[AMREX_SPACEDIM];
+                    rigid_point_velocity(motionptr+RIGID_MOTION_COMPS*rb,xn,vbody);
+                    amrex::Real contact_alpha=zero;
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        contact_alpha+=(vnew[d]-vbody[d])*rigid_arr(nodeid,NORMALX+d);
+                    }
+                    if(contact_alpha>=0)
+                    {
+                        for(int d=0;d<AMREX_SPACEDIM;d++)
+                        {
+                            vnew[d]-=contact_alpha*rigid_arr(nodeid,NORMALX+d);
+                        }
+                    }
+                }
+
+                apply_nodal_wall_bc(nodeid,vnew,tilebc,domlo,domhi,lsetarr);
+
+                for(int b=0;b<nlsbodies;b++)
+                {
+                    const LevelsetBody& body=lsbodyptr[b];
+                    if(body.value(xn)<=-lsband)
+                    {
+                        continue;
+                    }
+                    amrex::Real bnormal[AMREX_SPACEDIM];
+                    body.normal(xn,hgrad,bnormal);
+                    amrex::Real vbody[AMREX_SPACEDIM];
+                    body.velocity_at(xn,vbody);
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        relvel_in[d]=vnew[d]-vbody[d];
+                        relvel_out[d]=relvel_in[d];
+                    }
+                    applybc(relvel_in,relvel_out,body.wall_mu,bnormal,body.contact_bc);
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        vnew[d]=relvel_out[d]+vbody[d];
+                    }
+                }
+
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    slots[(MFC_VELX+d)*nslots+s]=vnew[d];
+                    slots[(MFC_DVELX+d)*nslots+s]=vnew[d]-slots[(MFC_MOMX+d)*nslots+s]/mf;
+                }
+            }
+        });
+    }
+}
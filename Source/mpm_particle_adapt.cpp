@@ -0,0 +1,457 @@
+#include <mpm_particle_container.H>
+#include <mpm_eb.H>
+#include <AMReX_DenseBins.H>
+#include <AMReX_Scan.H>
+
+using namespace amrex;
+
+namespace
+{
+    using ParticleType=MPMParticleContainer::ParticleType;
+
+    //largest principal stretch of F and its direction in the current
+    //configuration, from the dominant eigenpair of F F^T
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    Real principal_stretch(const ParticleType& p,Real e[AMREX_SPACEDIM])
+    {
+        const Real* F=&p.rdata(realData::deformation_gradient);
+        Real B[AMREX_SPACEDIM][AMREX_SPACEDIM];
+        for(int i=0;i<AMREX_SPACEDIM;i++)
+        {
+            for(int j=0;j<AMREX_SPACEDIM;j++)
+            {
+                B[i][j]=zero;
+                for(int k=0;k<AMREX_SPACEDIM;k++)
+                {
+                    B[i][j]+=F[i*AMREX_SPACEDIM+k]*F[j*AMREX_SPACEDIM+k];
+                }
+            }
+        }
+
+        //power iteration started from the largest column of B
+        int jmax=0;
+        Real cmax=-one;
+        for(int j=0;j<AMREX_SPACEDIM;j++)
+        {
+            Real c=B[XDIR][j]*B[XDIR][j]+B[YDIR][j]*B[YDIR][j]+B[ZDIR][j]*B[ZDIR][j];
+            if(c>cmax)
+            {
+                cmax=c;
+                jmax=j;
+            }
+        }
+        Real lambda2=zero;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            e[d]=B[d][jmax];
+        }
+        for(int it=0;it<20;it++)
+        {
+            Real emag=std::sqrt(e[XDIR]*e[XDIR]+e[YDIR]*e[YDIR]+e[ZDIR]*e[ZDIR]);
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                e[d]/=(emag+TINYVAL);
+            }
+            Real Be[AMREX_SPACEDIM];
+            lambda2=zero;
+            for(int i=0;i<AMREX_SPACEDIM;i++)
+            {
+                Be[i]=B[i][XDIR]*e[XDIR]+B[i][YDIR]*e[YDIR]+B[i][ZDIR]*e[ZDIR];
+                lambda2+=e[i]*Be[i];
+            }
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                e[d]=Be[d];
+            }
+        }
+        Real emag=std::sqrt(e[XDIR]*e[XDIR]+e[YDIR]*e[YDIR]+e[ZDIR]*e[ZDIR]);
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            e[d]/=(emag+TINYVAL);
+        }
+        return(std::sqrt(amrex::max(lambda2,zero)));
+    }
+
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    void set_radius(ParticleType& p)
+    {
+        p.rdata(realData::radius)=std::pow(three*fourth*p.rdata(realData::volume)/PI,0.33333333);
+    }
+
+    //points that can be merged share material, contact body and time level
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    bool mergeable(const ParticleType& a,const ParticleType& b)
+    {
+        return(a.idata(intData::constitutive_model)==b.idata(intData::constitutive_model) &&
+               a.idata(intData::contact_field)==b.idata(intData::contact_field) &&
+               a.idata(intData::dt_level)==b.idata(intData::dt_level) &&
+               a.rdata(realData::E)==b.rdata(realData::E) &&
+               a.rdata(realData::nu)==b.rdata(realData::nu) &&
+               a.rdata(realData::Bulk_modulus)==b.rdata(realData::Bulk_modulus) &&
+               a.rdata(realData::Gama_pressure)==b.rdata(realData::Gama_pressure) &&
+               a.rdata(realData::Dynamic_viscosity)==b.rdata(realData::Dynamic_viscosity) &&
+               a.rdata(realData::C01)==b.rdata(realData::C01));
+    }
+
+    //material points that take part in the cell counts
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    bool counted(const ParticleType& p)
+    {
+        return(p.id()>0 && p.idata(intData::phase)==0);
+    }
+
+    //sleeping points are frozen into the nodal cache and left as they are
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    bool adaptable(const ParticleType& p,int nsleep)
+    {
+        return(counted(p) && !(nsleep>0 && p.idata(intData::quiet_steps)>=nsleep));
+    }
+
+    //folds a into b; mass and momentum are conserved, the tensors are
+    //volume averaged and the reference volume follows the merged F
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    void merge_points(ParticleType& a,ParticleType& b)
+    {
+        Real ma=a.rdata(realData::mass);
+        Real mb=b.rdata(realData::mass);
+        Real va=a.rdata(realData::volume);
+        Real vb=b.rdata(realData::volume);
+        Real m=ma+mb;
+        Real v=va+vb;
+
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            b.pos(d)=(ma*a.pos(d)+mb*b.pos(d))/m;
+        }
+        const int mass_weighted[]={realData::xvel,realData::yvel,realData::zvel,
+                                   realData::xvel_prime,realData::yvel_prime,realData::zvel_prime,
+                                   realData::yacceleration};
+        for(int k=0;k<7;k++)
+        {
+            const int c=mass_weighted[k];
+            b.rdata(c)=(ma*a.rdata(c)+mb*b.rdata(c))/m;
+        }
+        const int tensors[]={realData::strainrate,realData::strain,realData::stress};
+        for(int k=0;k<3;k++)
+        {
+            for(int c=0;c<NCOMP_TENSOR;c++)
+            {
+                b.rdata(tensors[k]+c)=(va*a.rdata(tensors[k]+c)+vb*b.rdata(tensors[k]+c))/v;
+            }
+        }
+        for(int c=0;c<NCOMP_FULLTENSOR;c++)
+        {
+            b.rdata(realData::deformation_gradient+c)=(va*a.rdata(realData::deformation_gradient+c)
+                                                       +vb*b.rdata(realData::deformation_gradient+c))/v;
+        }
+        b.rdata(realData::pressure)=(va*a.rdata(realData::pressure)+vb*b.rdata(realData::pressure))/v;
+
+        const Real* F=&b.rdata(realData::deformation_gradient);
+        Real J=F[0]*(F[4]*F[8]-F[7]*F[5])-
+               F[1]*(F[3]*F[8]-F[6]*F[5])+
+               F[2]*(F[3]*F[7]-F[6]*F[4]);
+        b.rdata(realData::mass)=m;
+        b.rdata(realData::volume)=v;
+        b.rdata(realData::density)=m/v;
+        if(J>TINYVAL)
+        {
+            b.rdata(realData::jacobian)=J;
+            b.rdata(realData::vol_init)=v/J;
+        }
+        else
+        {
+            b.rdata(realData::vol_init)=a.rdata(realData::vol_init)+b.rdata(realData::vol_init);
+        }
+        set_radius(b);
+
+        a.id()=-1;
+        a.rdata(realData::mass)=zero;
+        a.rdata(realData::volume)=zero;
+    }
+
+    //the two halves of a split point sit a quarter of its deformed extent
+    //either side along the largest stretch
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    void split_positions(const ParticleType& p,Real xm[AMREX_SPACEDIM],Real xp[AMREX_SPACEDIM])
+    {
+        Real e[AMREX_SPACEDIM];
+        Real lambda=principal_stretch(p,e);
+        Real offset=fourth*lambda*std::cbrt(p.rdata(realData::vol_init));
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            xm[d]=p.pos(d)-offset*e[d];
+            xp[d]=p.pos(d)+offset*e[d];
+        }
+    }
+}
+
+void MPMParticleContainer::adapt_particles(int min_ppc,int max_ppc,
+                                           amrex::Real split_stretch,amrex::Real split_jacobian,
+                                           amrex::Long &nsplit,amrex::Long &nmerged)
+{
+    BL_PROFILE("MPMParticleContainer::adapt_particles");
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    const auto plo = geom.ProbLoArray();
+    const auto phi = geom.ProbHiArray();
+    const auto dx = geom.CellSizeArray();
+    const auto dxi = geom.InvCellSizeArray();
+    const int lsref = mpm_ebtools::ls_refinement;
+    const int nsleep=sleep_after;
+
+    ReduceOps<ReduceOpSum,ReduceOpSum> reduce_op;
+    ReduceData<Long,Long> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+    //children are appended to the tiles, so the neighbour copies go first
+    clearNeighbors();
+
+    for (MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        const int grid_id = mfi.index();
+        const int tile_id = mfi.LocalTileIndex();
+        auto& ptile = GetParticles(lev)[std::make_pair(grid_id, tile_id)];
+        auto& aos = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+        if(np==0)
+        {
+            continue;
+        }
+        ParticleType* pstruct = aos().dataPtr();
+
+        //material points binned by the cell they are in now, they may have
+        //left the tile by up to the drift since the last redistribution
+        const Box binbox=amrex::grow(mfi.tilebox(),gather_drift_cells);
+        const IntVect binlo=binbox.smallEnd();
+        const IntVect binhi=binbox.bigEnd();
+        DenseBins<ParticleType> bins;
+        bins.build(np,pstruct,binbox,[=] AMREX_GPU_DEVICE (const ParticleType& p) noexcept -> IntVect
+        {
+            IntVect iv(AMREX_D_DECL(static_cast<int>(amrex::Math::floor((p.pos(XDIR)-plo[XDIR])*dxi[XDIR])),
+                                    static_cast<int>(amrex::Math::floor((p.pos(YDIR)-plo[YDIR])*dxi[YDIR])),
+                                    static_cast<int>(amrex::Math::floor((p.pos(ZDIR)-plo[ZDIR])*dxi[ZDIR]))));
+            iv.max(binlo);
+            iv.min(binhi);
+            return(iv);
+        });
+        const int nbins=bins.numBins();
+        const auto offsets=bins.offsetsPtr();
+        const auto perm=bins.permutationPtr();
+
+        //split children may not land inside a wall, as for the initial points
+        const bool check_ls=(mpm_ebtools::using_levelset_geometry && mpm_ebtools::near_eb(mfi));
+        amrex::Array4<amrex::Real> lsetarr;
+        if(check_ls)
+        {
+            lsetarr=mpm_ebtools::lsphi->array(mfi);
+        }
+
+        Gpu::DeviceVector<int> split_flag(np,0);
+        int* flagptr=split_flag.data();
+
+        //one thread per cell merges or picks the points to split
+        reduce_op.eval(nbins,reduce_data,[=]
+        AMREX_GPU_DEVICE (int c) -> ReduceTuple
+        {
+            const int start=offsets[c];
+            const int stop=offsets[c+1];
+            int n=0;
+            for(int k=start;k<stop;k++)
+            {
+                n+=counted(pstruct[perm[k]]);
+            }
+
+            Long merged=0;
+            Long split=0;
+            if(n>max_ppc)
+            {
+                //points are visited from the lightest and merged into their
+                //nearest partner until the cell is back to max_ppc
+                int excess=n-max_ppc;
+                Real mlast=-one;
+                int ilast=-1;
+                while(excess>0)
+                {
+                    int a=-1;
+                    Real ma=BIGVAL;
+                    for(int k=start;k<stop;k++)
+                    {
+                        const int i=perm[k];
+                        if(!counted(pstruct[i]))
+                        {
+                            continue;
+                        }
+                        Real m=pstruct[i].rdata(realData::mass);
+                        bool after=(m>mlast || (m==mlast && i>ilast));
+                        if(after && (m<ma || (m==ma && i<a)))
+                        {
+                            a=i;
+                            ma=m;
+                        }
+                    }
+                    if(a<0)
+                    {
+                        break;
+                    }
+                    mlast=ma;
+                    ilast=a;
+
+                    ParticleType& pa=pstruct[a];
+                    if(!adaptable(pa,nsleep))
+                    {
+                        continue;
+                    }
+                    int bmin=-1;
+                    Real dmin=BIGVAL;
+                    for(int k=start;k<stop;k++)
+                    {
+                        const int b=perm[k];
+                        const ParticleType& pb=pstruct[b];
+                        if(b==a || !adaptable(pb,nsleep) || !mergeable(pa,pb))
+                        {
+                            continue;
+                        }
+                        Real dist=(pa.pos(XDIR)-pb.pos(XDIR))*(pa.pos(XDIR)-pb.pos(XDIR))
+                                 +(pa.pos(YDIR)-pb.pos(YDIR))*(pa.pos(YDIR)-pb.pos(YDIR))
+                                 +(pa.pos(ZDIR)-pb.pos(ZDIR))*(pa.pos(ZDIR)-pb.pos(ZDIR));
+                        if(dist<dmin)
+                        {
+                            dmin=dist;
+                            bmin=b;
+                        }
+                    }
+                    if(bmin>=0)
+                    {
+                        merge_points(pa,pstruct[bmin]);
+                        excess--;
+                        merged++;
+                    }
+                }
+            }
+            else if(n<min_ppc)
+            {
+                //the most stretched points are halved along their largest stretch
+                int budget=min_ppc-n;
+                Real llast=BIGVAL;
+                int ilast=-1;
+                while(budget>0)
+                {
+                    int a=-1;
+                    Real la=-one;
+                    for(int k=start;k<stop;k++)
+                    {
+                        const int i=perm[k];
+                        const ParticleType& p=pstruct[i];
+                        if(!adaptable(p,nsleep))
+                        {
+                            continue;
+                        }
+                        Real e[AMREX_SPACEDIM];
+                        Real lambda=principal_stretch(p,e);
+                        if(!(lambda>split_stretch || p.rdata(realData::jacobian)>split_jacobian))
+                        {
+                            continue;
+                        }
+                        bool after=(lambda<llast || (lambda==llast && i>ilast));
+                        if(after && (lambda>la || (lambda==la && i<a)))
+                        {
+                            a=i;
+                            la=lambda;
+                        }
+                    }
+                    if(a<0)
+                    {
+                        break;
+                    }
+                    llast=la;
+                    ilast=a;
+                    budget--;
+
+                    Real xm[AMREX_SPACEDIM],xp[AMREX_SPACEDIM];
+                    split_positions(pstruct[a],xm,xp);
+                    bool inside=true;
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        inside=inside && xm[d]>plo[d] && xm[d]<phi[d] && xp[d]>plo[d] && xp[d]<phi[d];
+                    }
+                    for(int h=0;h<2 && inside && check_ls;h++)
+                    {
+                        Real* x=(h==0)?xm:xp;
+                        IntVect lsiv(AMREX_D_DECL(static_cast<int>(amrex::Math::floor((x[XDIR]-plo[XDIR]+TINYVAL)*dxi[XDIR]*lsref)),
+                                                  static_cast<int>(amrex::Math::floor((x[YDIR]-plo[YDIR]+TINYVAL)*dxi[YDIR]*lsref)),
+                                                  static_cast<int>(amrex::Math::floor((x[ZDIR]-plo[ZDIR]+TINYVAL)*dxi[ZDIR]*lsref))));
+                        inside=(lsetarr.contains(lsiv[XDIR],lsiv[YDIR],lsiv[ZDIR]) &&
+                                lsetarr.contains(lsiv[XDIR]+1,lsiv[YDIR]+1,lsiv[ZDIR]+1) &&
+                                get_levelset_value(lsetarr,plo,dx,x,lsref)>=TINYVAL);
+                    }
+                    if(inside)
+                    {
+                        flagptr[a]=1;
+                        split++;
+                    }
+                }
+            }
+            return {merged,split};
+        });
+
+        //children go behind the real particles, with ids reserved in one block
+        Gpu::DeviceVector<int> child_index(np);
+        int* childptr=child_index.data();
+        const int nchildren=Scan::PrefixSum<int>(np,
+        [=] AMREX_GPU_DEVICE (int i) -> int
+        {
+            return(flagptr[i]);
+        },
+        [=] AMREX_GPU_DEVICE (int i, int const& x)
+        {
+            childptr[i]=x;
+        },
+        Scan::Type::exclusive, Scan::retSum);
+        if(nchildren==0)
+        {
+            continue;
+        }
+
+        const Long id0=ParticleType::NextID();
+        ParticleType::NextID(id0+nchildren);
+        const int cpu=ParallelDescriptor::MyProc();
+        ptile.resize(np+nchildren);
+        ParticleType* pnew=ptile.GetArrayOfStructs()().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            if(!flagptr[i])
+            {
+                return;
+            }
+            ParticleType& p=pnew[i];
+            Real xm[AMREX_SPACEDIM],xp[AMREX_SPACEDIM];
+            split_positions(p,xm,xp);
+
+            p.rdata(realData::mass)*=half;
+            p.rdata(realData::volume)*=half;
+            p.rdata(realData::vol_init)*=half;
+            set_radius(p);
+
+            ParticleType child=p;
+            child.id()=id0+childptr[i];
+            child.cpu()=cpu;
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                p.pos(d)=xm[d];
+                child.pos(d)=xp[d];
+            }
+            pnew[np+childptr[i]]=child;
+        });
+        Gpu::streamSynchronize();
+    }
+
+    ReduceTuple hv=reduce_data.value(reduce_op);
+    nmerged=amrex::get<0>(hv);
+    nsplit=amrex::get<1>(hv);
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceLongSum(nsplit);
+    ParallelDescriptor::ReduceLongSum(nmerged);
+#endif
+}
@@ -0,0 +1,638 @@
+#include <mpm_particle_container.H>
+#include <interpolants.H>
+#include <mpm_kernels.H>
+#include <constitutive_engine.H>
+#include <nodal_data_ops.H>
+
+using namespace amrex;
+
+//Everything the fused advance of one point reads, so the body can be
+//instantiated once per constitutive model
+struct ParticleAdvanceArgs
+{
+    amrex::Array4<amrex::Real> nodal_data_arr;
+    ContactFieldView cview;
+    ParticleWallBC tilebc;
+    amrex::Array4<amrex::Real> lsetarr;
+    amrex::Box driftbox;
+    amrex::Box domain;
+    amrex::GpuArray<amrex::Real,AMREX_SPACEDIM> plo;
+    amrex::GpuArray<amrex::Real,AMREX_SPACEDIM> dx;
+    amrex::GpuArray<amrex::Real,AMREX_SPACEDIM> dxi;
+    amrex::GpuArray<int,AMREX_SPACEDIM> lo;
+    amrex::GpuArray<int,AMREX_SPACEDIM> hi;
+    amrex::GpuArray<int,AMREX_SPACEDIM> order_scheme_directional;
+    amrex::GpuArray<int,AMREX_SPACEDIM> periodic;
+    amrex::Real dxmin;
+    amrex::Real dt;
+    amrex::Real alpha_pic_flip;
+    amrex::Real applied_strainrate;
+    int delta_form;
+    EOSTableView eos;
+    int nlev;
+    int kmin;
+    int update_position;
+    int update_stress;
+    int nsleep;
+    amrex::Real sleep_v2;
+    amrex::Real sleep_sr2;
+    amrex::Real wake_v2;
+};
+
+//CFL time scale, removed mass and momentum, removed count, sleep changes
+//and particles past the drift box
+using ParticleAdvanceTuple = amrex::GpuTuple<Real,Real,Real,Real,Real,Long,Long,Long>;
+
+//Deformation gradient, strain rate and stress of a point that uses Model
+template<int Model>
+struct AdvancePointStress
+{
+    static constexpr bool active=true;
+
+    AMREX_GPU_DEVICE AMREX_FORCE_INLINE
+    static void apply(MPMParticleContainer::ParticleType& p,
+                      amrex::Real gradvp[AMREX_SPACEDIM][AMREX_SPACEDIM],
+                      const ParticleAdvanceArgs& a)
+    {
+        //each multi-rate level integrates over its own step
+        const amrex::Real dt_p=a.dt*(1<<(a.nlev-1-p.idata(intData::dt_level)));
+
+        get_deformation_gradient_tensor(p,realData::deformation_gradient,gradvp,dt_p);
+
+        int ind=0;
+        for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+        {
+            for(int d2=d1;d2<AMREX_SPACEDIM;d2++)
+            {
+                p.rdata(realData::strainrate+ind)=half*(gradvp[d1][d2]+gradvp[d2][d1]);
+                ind++;
+            }
+        }
+
+        update_point_volume(p);
+        constitutive_point_update<Model>(p,dt_p,a.applied_strainrate,a.delta_form,a.eos);
+    }
+};
+
+//rigid, removed, sleeping and inactive-level points keep their stress
+template<>
+struct AdvancePointStress<NUM_CONSTITUTIVE_MODELS>
+{
+    static constexpr bool active=false;
+
+    AMREX_GPU_DEVICE AMREX_FORCE_INLINE
+    static void apply(MPMParticleContainer::ParticleType& /*p*/,
+                      amrex::Real /*gradvp*/[AMREX_SPACEDIM][AMREX_SPACEDIM],
+                      const ParticleAdvanceArgs& /*a*/)
+    {
+    }
+};
+
+//Group of a point in the stress sweep: its model when the stress is
+//updated, NUM_CONSTITUTIVE_MODELS otherwise
+AMREX_GPU_DEVICE AMREX_FORCE_INLINE
+int advance_group(const MPMParticleContainer::ParticleType& p,const ParticleAdvanceArgs& a)
+{
+    const int model=p.idata(intData::constitutive_model);
+    const bool asleep=(a.nsleep>0 && p.idata(intData::quiet_steps)>=a.nsleep);
+    return((p.idata(intData::phase)==0 && p.id()>=0 && !asleep &&
+            p.idata(intData::dt_level)>=a.kmin && model>=0 && model<NUM_CONSTITUTIVE_MODELS)?
+           model:NUM_CONSTITUTIVE_MODELS);
+}
+
+//G2P, move and, for points of a model group, the stress update of one point
+template<int Model>
+AMREX_GPU_DEVICE AMREX_FORCE_INLINE
+ParticleAdvanceTuple advance_material_point(MPMParticleContainer::ParticleType& p,const ParticleAdvanceArgs& a)
+{
+    int lmin,lmax,nmin,nmax,mmin,mmax;
+    amrex::Real tscale=std::numeric_limits<amrex::Real>::max();
+    const auto& plo=a.plo;
+    const auto& dx=a.dx;
+    const auto& dxi=a.dxi;
+    const auto& domain=a.domain;
+    const auto& order_scheme_directional=a.order_scheme_directional;
+    const auto& periodic=a.periodic;
+    const int* lo=a.lo.data();
+    const int* hi=a.hi.data();
+    const amrex::Real dt=a.dt;
+    const int update_position=a.update_position;
+    const int update_stress=a.update_stress;
+    const int nsleep=a.nsleep;
+    Array4<Real> const& nodal_data_arr=a.nodal_data_arr;
+
+    if(p.idata(intData::phase)==1)
+    {
+        if(update_position)
+        {
+            p.pos(XDIR) += p.rdata(realData::xvel_prime) * dt;
+            p.pos(YDIR) += p.rdata(realData::yvel_prime) * dt;
+            p.pos(ZDIR) += p.rdata(realData::zvel_prime) * dt;
+        }
+        return {tscale,zero,zero,zero,zero,0,0,0};
+    }
+    if(p.id()<0)
+    {
+        return {tscale,zero,zero,zero,zero,0,0,0};
+    }
+
+    //a sleeping point only watches the nodes of its cell
+    if(nsleep>0 && p.idata(intData::quiet_steps)>=nsleep)
+    {
+        Long woke=0;
+        if(update_position)
+        {
+            auto ivc = getParticleCell(p, plo, dxi, domain);
+            amrex::Real vmax2=zero;
+            for(int n=0;n<2;n++)
+            {
+                for(int m=0;m<2;m++)
+                {
+                    for(int l=0;l<2;l++)
+                    {
+                        IntVect ivnode(ivc[XDIR]+l,ivc[YDIR]+m,ivc[ZDIR]+n);
+                        amrex::Real v2=zero;
+                        for(int d=0;d<AMREX_SPACEDIM;d++)
+                        {
+                            v2+=nodal_data_arr(ivnode,VELX_INDEX+d)*nodal_data_arr(ivnode,VELX_INDEX+d);
+                        }
+                        vmax2=amrex::max(vmax2,v2);
+                    }
+                }
+            }
+            if(vmax2>a.wake_v2)
+            {
+                p.idata(intData::quiet_steps)=0;
+                woke=1;
+            }
+        }
+        if(update_stress)
+        {
+            amrex::Real modulus=pwave_modulus(p.idata(intData::constitutive_model),p.rdata(realData::E),
+                                              p.rdata(realData::nu),p.rdata(realData::Bulk_modulus));
+            tscale=cfl_timescale(modulus,p.rdata(realData::density),p.rdata(realData::xvel),
+                                 p.rdata(realData::yvel),p.rdata(realData::zvel),a.dxmin);
+        }
+        return {tscale,zero,zero,zero,zero,0,woke,0};
+    }
+
+    const bool stress_active=AdvancePointStress<Model>::active;
+
+    amrex::Real xp[AMREX_SPACEDIM];
+    xp[XDIR]=p.pos(XDIR);
+    xp[YDIR]=p.pos(YDIR);
+    xp[ZDIR]=p.pos(ZDIR);
+
+    auto iv = getParticleCell(p, plo, dxi, domain);
+
+    lmin=(order_scheme_directional[0]==1)?0:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?0:((iv[XDIR]==hi[XDIR])?-1:-1):-1000);
+    lmax=(order_scheme_directional[0]==1)?2:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?lmin+3:((iv[XDIR]==hi[XDIR])?lmin+3:lmin+4):-1000);
+
+    mmin=(order_scheme_directional[1]==1)?0:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?0:((iv[YDIR]==hi[YDIR])?-1:-1):-1000);
+    mmax=(order_scheme_directional[1]==1)?2:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?mmin+3:((iv[YDIR]==hi[YDIR])?mmin+3:mmin+4):-1000);
+
+    nmin=(order_scheme_directional[2]==1)?0:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?0:((iv[ZDIR]==hi[ZDIR])?-1:-1):-1000);
+    nmax=(order_scheme_directional[2]==1)?2:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?nmin+3:((iv[ZDIR]==hi[ZDIR])?nmin+3:nmin+4):-1000);
+
+    if(lmin==-1000 or lmax==-1000 or mmin==-1000 or mmax==-1000 or nmin==-1000 or nmax==-1000)
+    {
+        amrex::Abort("\nError. Something wrong with min/max index values in advance_particles");
+    }
+
+    const int cfield=p.idata(intData::contact_field);
+
+    //one pass over the stencil gathers velocity, velocity change and gradient
+    amrex::Real vgrid[AMREX_SPACEDIM]={zero,zero,zero};
+    amrex::Real dvgrid[AMREX_SPACEDIM]={zero,zero,zero};
+    amrex::Real gradvp[AMREX_SPACEDIM][AMREX_SPACEDIM]={{zero}};
+
+    for(int n=nmin;n<nmax;n++)
+    {
+        for(int m=mmin;m<mmax;m++)
+        {
+            for(int l=lmin;l<lmax;l++)
+            {
+                IntVect ivnode(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n);
+                const int cs=a.cview.slot(ivnode,cfield);
+                amrex::Real nodevel[AMREX_SPACEDIM];
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    nodevel[d]=(cs>=0)?a.cview.get(MFC_VELX+d,cs):nodal_data_arr(ivnode,VELX_INDEX+d);
+                }
+
+                if(update_position)
+                {
+                    amrex::Real basisvalue=basisval(l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        vgrid[d]+=basisvalue*nodevel[d];
+                        dvgrid[d]+=basisvalue*((cs>=0)?a.cview.get(MFC_DVELX+d,cs):
+                                               nodal_data_arr(ivnode,DELTA_VELX_INDEX+d));
+                    }
+                }
+
+                if(stress_active)
+                {
+                    amrex::Real basisval_grad[AMREX_SPACEDIM];
+                    for(int d=0;d<AMREX_SPACEDIM;d++)
+                    {
+                        basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+                    }
+                    for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+                    {
+                        for(int d2=0;d2<AMREX_SPACEDIM;d2++)
+                        {
+                            gradvp[d1][d2]+=nodevel[d1]*basisval_grad[d2];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Long escaped=0;
+    if(update_position)
+    {
+        amrex::Real yvel_old=p.rdata(realData::yvel);
+        amrex::Real vel[AMREX_SPACEDIM];
+        vel[XDIR]=p.rdata(realData::xvel);
+        vel[YDIR]=p.rdata(realData::yvel);
+        vel[ZDIR]=p.rdata(realData::zvel);
+
+        //PIC/FLIP blend
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            vel[d]=a.alpha_pic_flip*(vel[d]+dvgrid[d])+(1-a.alpha_pic_flip)*vgrid[d];
+        }
+        p.rdata(realData::xvel_prime)=vgrid[XDIR];
+        p.rdata(realData::yvel_prime)=vgrid[YDIR];
+        p.rdata(realData::zvel_prime)=vgrid[ZDIR];
+        p.rdata(realData::yacceleration)=(vel[YDIR]-yvel_old)/dt;
+
+        amrex::Real pos[AMREX_SPACEDIM]={xp[XDIR],xp[YDIR],xp[ZDIR]};
+        bool removed=move_material_point(pos,vel,vgrid,dt,a.tilebc,a.lsetarr);
+
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            p.pos(d)=pos[d];
+        }
+        p.rdata(realData::xvel)=vel[XDIR];
+        p.rdata(realData::yvel)=vel[YDIR];
+        p.rdata(realData::zvel)=vel[ZDIR];
+
+        //invalid until the next Redistribute drops it, without mass
+        //or volume it no longer loads the grid
+        if(removed)
+        {
+            const amrex::Real mp=p.rdata(realData::mass);
+            p.id()=-1;
+            p.rdata(realData::mass)=zero;
+            p.rdata(realData::volume)=zero;
+            return {tscale,mp,mp*vel[XDIR],mp*vel[YDIR],mp*vel[ZDIR],1,0,0};
+        }
+        escaped=(a.driftbox.contains(getParticleCell(p,plo,dxi,domain)))?0:1;
+    }
+
+    if(stress_active)
+    {
+        AdvancePointStress<Model>::apply(p,gradvp,a);
+    }
+
+    if(update_stress)
+    {
+        amrex::Real modulus=pwave_modulus(p.idata(intData::constitutive_model),p.rdata(realData::E),
+                                          p.rdata(realData::nu),p.rdata(realData::Bulk_modulus));
+        tscale=cfl_timescale(modulus,p.rdata(realData::density),p.rdata(realData::xvel),
+                             p.rdata(realData::yvel),p.rdata(realData::zvel),a.dxmin);
+    }
+
+    //quiet steps are counted once per step, at the stress update
+    Long slept=0;
+    if(nsleep>0 && update_stress)
+    {
+        amrex::Real v2=p.rdata(realData::xvel)*p.rdata(realData::xvel)
+                      +p.rdata(realData::yvel)*p.rdata(realData::yvel)
+                      +p.rdata(realData::zvel)*p.rdata(realData::zvel);
+        amrex::Real sr2=zero;
+        for(int c=0;c<NCOMP_TENSOR;c++)
+        {
+            amrex::Real sr=p.rdata(realData::strainrate+c);
+            sr2+=((c==XX || c==YY || c==ZZ)?one:two)*sr*sr;
+        }
+        if(v2<a.sleep_v2 && sr2<a.sleep_sr2)
+        {
+            p.idata(intData::quiet_steps)+=1;
+            if(p.idata(intData::quiet_steps)==nsleep)
+            {
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    p.rdata(realData::xvel+d)=zero;
+                    p.rdata(realData::xvel_prime+d)=zero;
+                }
+                for(int c=0;c<NCOMP_TENSOR;c++)
+                {
+                    p.rdata(realData::strainrate+c)=zero;
+                }
+                slept=1;
+            }
+        }
+        else
+        {
+            p.idata(intData::quiet_steps)=0;
+        }
+    }
+    return {tscale,zero,zero,zero,zero,0,slept,escaped};
+}
+
+//Runs the points pstruct[idx[0..n-1]] (pstruct[0..n-1] without idx) of
+//one group through the advance instantiated for Model
+template<int Model,typename RO,typename RD>
+void advance_point_group(RO& reduce_op,RD& reduce_data,MPMParticleContainer::ParticleType* pstruct,
+                         const int* idx,int n,const ParticleAdvanceArgs& args)
+{
+    reduce_op.eval(n, reduce_data, [=]
+    AMREX_GPU_DEVICE (int i) -> ParticleAdvanceTuple
+    {
+        return(advance_material_point<Model>(pstruct[(idx)?idx[i]:i],args));
+    });
+}
+
+//Compile-time walk from a runtime group id to its advance kernel, the
+//last group holds the points without a stress update
+template<int Model>
+struct AdvanceDispatch
+{
+    template<typename RO,typename RD>
+    static void apply(int group,RO& reduce_op,RD& reduce_data,MPMParticleContainer::ParticleType* pstruct,
+                      const int* idx,int n,const ParticleAdvanceArgs& args)
+    {
+        if(group==Model)
+        {
+            advance_point_group<Model>(reduce_op,reduce_data,pstruct,idx,n,args);
+        }
+        else
+        {
+            AdvanceDispatch<Model+1>::apply(group,reduce_op,reduce_data,pstruct,idx,n,args);
+        }
+    }
+};
+
+template<>
+struct AdvanceDispatch<NUM_CONSTITUTIVE_MODELS>
+{
+    template<typename RO,typename RD>
+    static void apply(int /*group*/,RO& reduce_op,RD& reduce_data,MPMParticleContainer::ParticleType* pstruct,
+                      const int* idx,int n,const ParticleAdvanceArgs& args)
+    {
+        advance_point_group<NUM_CONSTITUTIVE_MODELS>(reduce_op,reduce_data,pstruct,idx,n,args);
+    }
+};
+
+void MPMParticleContainer::advance_particles(MultiFab& nodaldata,const amrex::Real& dt,
+                                             int update_position,int update_stress,
+                                             GpuArray <int,AMREX_SPACEDIM> order_scheme_directional,
+                                             GpuArray <int,AMREX_SPACEDIM> periodic,
+                                             amrex::Real alpha_pic_flip,
+                                             int bclo[AMREX_SPACEDIM],int bchi[AMREX_SPACEDIM],
+                                             int lsetbc,
+                                             amrex::Real wall_mu_lo[AMREX_SPACEDIM],
+                                             amrex::Real wall_mu_hi[AMREX_SPACEDIM],
+                                             amrex::Real wall_vel_lo[AMREX_SPACEDIM*AMREX_SPACEDIM],
+                                             amrex::Real wall_vel_hi[AMREX_SPACEDIM*AMREX_SPACEDIM],
+                                             amrex::Real lset_wall_mu,
+                                             amrex::Real applied_strainrate,
+                                             int delta_form)
+{
+    BL_PROFILE("MPMParticleContainer::advance_particles");
+
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    auto& plev  = GetParticles(lev);
+    const auto dx = geom.CellSizeArray();
+    const auto domain = geom.Domain();
+
+    ParticleWallBC wallbc=make_particle_wall_bc(geom,bclo,bchi,lsetbc,wall_mu_lo,wall_mu_hi,
+                                                wall_vel_lo,wall_vel_hi,lset_wall_mu);
+    set_particle_sinks(wallbc,sink_regions);
+
+    ParticleAdvanceArgs args;
+    args.domain=domain;
+    args.plo=geom.ProbLoArray();
+    args.dx=dx;
+    args.dxi=geom.InvCellSizeArray();
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        args.lo[d]=domain.smallEnd(d);
+        args.hi[d]=domain.bigEnd(d);
+    }
+    args.order_scheme_directional=order_scheme_directional;
+    args.periodic=periodic;
+    args.dxmin=amrex::min<amrex::Real>(dx[0],amrex::min<amrex::Real>(dx[1],dx[2]));
+    args.dt=dt;
+    args.alpha_pic_flip=alpha_pic_flip;
+    args.applied_strainrate=applied_strainrate;
+    args.delta_form=delta_form;
+    args.eos=eos_table_view();
+    args.nlev=mr_nlevels;
+    args.kmin=mr_min_active_level;
+    args.update_position=update_position;
+    args.update_stress=update_stress;
+    args.nsleep=sleep_after;
+    args.sleep_v2=sleep_velocity*sleep_velocity;
+    args.sleep_sr2=sleep_strainrate*sleep_strainrate;
+    args.wake_v2=wake_velocity*wake_velocity;
+
+    //velocity for both stages, velocity change only for the FLIP update
+    const IntVect ng_gather=nodal_gather_ghosts(order_scheme_directional,gather_drift_cells);
+    fill_nodal_ghosts(nodaldata,geom,VELX_INDEX,AMREX_SPACEDIM,ng_gather);
+    if(update_position)
+    {
+        fill_nodal_ghosts(nodaldata,geom,DELTA_VELX_INDEX,AMREX_SPACEDIM,ng_gather);
+    }
+
+    //the stress stage closes the step, so it also accumulates the CFL estimate;
+    //the position stage sums the material removed at outflows and sinks.
+    //The seventh entry counts particles that fell asleep or woke up, the
+    //eighth those that moved past the drift the nodal ghosts are sized for.
+    const int nsleep=sleep_after;
+    ReduceOps<ReduceOpMin,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum> reduce_op;
+    ReduceData<Real,Real,Real,Real,Real,Long,Long,Long> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+    //the group lists are sized once for the largest tile, so none of them
+    //moves while the kernels of the previous tile still read it
+    Vector<Gpu::DeviceVector<int>> group_index(NUM_CONSTITUTIVE_MODELS+1);
+    if(update_stress)
+    {
+        int npmax=0;
+        for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+        {
+            auto index = std::make_pair(mfi.index(), mfi.LocalTileIndex());
+            npmax=amrex::max(npmax,plev[index].GetArrayOfStructs().numRealParticles());
+        }
+        for(int group=0;group<=NUM_CONSTITUTIVE_MODELS;group++)
+        {
+            group_index[group].resize(npmax);
+        }
+    }
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+        if(np==0)
+        {
+            continue;
+        }
+
+        ParticleAdvanceArgs targs=args;
+        targs.nodal_data_arr=nodaldata.array(mfi);
+
+        //per-body velocities at nodes shared by several bodies
+        targs.cview=contact_field_view(index);
+
+        //tiles away from the level-set narrow band skip the wall query
+        targs.tilebc=wallbc;
+        targs.tilebc.using_levsets=(wallbc.using_levsets && mpm_ebtools::near_eb(mfi));
+        if(targs.tilebc.using_levsets)
+        {
+            targs.lsetarr=mpm_ebtools::lsphi->array(mfi);
+        }
+
+        //cells the tile's particles may reach before the next redistribution
+        targs.driftbox=amrex::grow(mfi.tilebox(),gather_drift_cells);
+
+        ParticleType* pstruct = aos().dataPtr();
+
+        //the position-only stage has no model specific work
+        if(!update_stress)
+        {
+            AdvanceDispatch<0>::apply(NUM_CONSTITUTIVE_MODELS,reduce_op,reduce_data,pstruct,
+                                      nullptr,np,targs);
+            continue;
+        }
+
+        //partition the tile into one index list per model, plus one for the
+        //points whose stress is not updated, and run each through its own kernel
+        for(int group=0;group<=NUM_CONSTITUTIVE_MODELS;group++)
+        {
+            int* idx=group_index[group].dataPtr();
+
+            int ngroup=Scan::PrefixSum<int>(np,
+            [=] AMREX_GPU_DEVICE (int i) -> int
+            {
+                return(advance_group(pstruct[i],targs)==group);
+            },
+            [=] AMREX_GPU_DEVICE (int i, int const& s)
+            {
+                if(advance_group(pstruct[i],targs)==group)
+                {
+                    idx[s]=i;
+                }
+            },
+            Scan::Type::exclusive,Scan::retSum);
+
+            if(ngroup>0)
+            {
+                AdvanceDispatch<0>::apply(group,reduce_op,reduce_data,pstruct,idx,ngroup,targs);
+            }
+        }
+    }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    if(update_stress)
+    {
+        dt_scale_local = amrex::get<0>(hv);
+        dt_scale_valid = true;
+    }
+    if(update_position)
+    {
+        removed_mass_local += amrex::get<1>(hv);
+        removed_momentum_local[XDIR] += amrex::get<2>(hv);
+        removed_momentum_local[YDIR] += amrex::get<3>(hv);
+        removed_momentum_local[ZDIR] += amrex::get<4>(hv);
+        removed_count_local += amrex::get<5>(hv);
+
+        //the gathers before the next redistribution would read past the ghosts
+        if(amrex::get<7>(hv)>0)
+        {
+            amrex::Abort("\nA particle moved farther than the nodal ghost width allows before the next "
+                         "redistribution, lower mpm.num_redist or the time step");
+        }
+    }
+
+    //any change of the sleeping set invalidates the cached contribution on
+    //every rank, since neighbour copies deposit across boxes
+    if(nsleep>0)
+    {
+        Long sleep_changes=amrex::get<6>(hv);
+#ifdef BL_USE_MPI
+        ParallelDescriptor::ReduceLongSum(sleep_changes);
+#endif
+        if(sleep_changes>0)
+        {
+            sleep_cache_valid=0;
+        }
+    }
+}
+
+amrex::Long MPMParticleContainer::sleeping_particle_count()
+{
+    const int nsleep=sleep_after;
+    using PType = typename MPMParticleContainer::SuperParticleType;
+    Long count = amrex::ReduceSum(*this, [=]
+    AMREX_GPU_HOST_DEVICE (const PType& p) -> Long
+    {
+        return((p.idata(intData::phase)==0 && p.id()>=0 && nsleep>0 &&
+                p.idata(intData::quiet_steps)>=nsleep)?1:0);
+    });
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceLongSum(count);
+#endif
+    return(count);
+}
+
+amrex::Long MPMParticleContainer::removed_particle_totals(amrex::Real &mass,amrex::Real momentum[AMREX_SPACEDIM])
+{
+    amrex::Long count=removed_count_local;
+    mass=removed_mass_local;
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        momentum[d]=removed_momentum_local[d];
+    }
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceLongSum(count);
+    ParallelDescriptor::ReduceRealSum(mass);
+    ParallelDescriptor::ReduceRealSum(momentum,AMREX_SPACEDIM);
+#endif
+    removed_count_local=0;
+    removed_mass_local=zero;
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        removed_momentum_local[d]=zero;
+    }
+    return(count);
+}
+
+void MPMParticleContainer::check_delta_form_support()
+{
+    using PType = typename MPMParticleContainer::SuperParticleType;
+    int unsupported = amrex::ReduceMax(*this, [=]
+    AMREX_GPU_HOST_DEVICE (const PType& p) -> int
+    {
+        return((p.idata(intData::phase)==0 &&
+                !constitutive_has_delta_form(p.idata(intData::constitutive_model)))?1:0);
+    });
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceIntMax(unsupported);
+#endif
+    if(unsupported)
+    {
+        amrex::Abort("\nDelta strain form is not implemented for one of the constitutive models in use");
+    }
+}
@@ -1,160 +1,159 @@
 #include <mpm_particle_container.H>
 #include <interpolants.H>
 #include <constitutive_models.H>
+#include <constitutive_engine.H>
+#include <AMReX_Scan.H>
 
 using namespace amrex;
 
 void MPMParticleContainer::apply_constitutive_model(const amrex::Real& dt,
                                                     amrex::Real applied_strainrate=0.0)
 {
+    apply_constitutive_engine(dt,applied_strainrate,0);
+} 
+
+void MPMParticleContainer::apply_constitutive_model_delta(const amrex::Real& dt,
+                                                          amrex::Real applied_strainrate=0.0)
+{
+    apply_constitutive_engine(dt,applied_strainrate,1);
+}
+
+void MPMParticleContainer::apply_constitutive_engine(const amrex::Real& dt,
+                                                     amrex::Real applied_strainrate,
+                                                     int delta_form)
+{
+    BL_PROFILE("MPMParticleContainer::apply_constitutive_engine");
+
     const int lev = 0;
-    const Geometry& geom = Geom(lev);
     auto& plev  = GetParticles(lev);
-    const auto dxi = geom.InvCellSizeArray();
-    const auto dx = geom.CellSizeArray();
-    const auto plo = geom.ProbLoArray();
-    const auto domain = geom.Domain();
+    const int nlev=mr_nlevels;
+    const int kmin=mr_min_active_level;
+
+    EOSTableView eos=eos_table_view();
+
+    Vector<Gpu::DeviceVector<int>> group_index(NUM_CONSTITUTIVE_MODELS);
 
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
-        const amrex::Box& box = mfi.tilebox();
         int gid = mfi.index();
         int tid = mfi.LocalTileIndex();
         auto index = std::make_pair(gid, tid);
-        Real pinf=0.0;
 
         auto& ptile = plev[index];
         auto& aos   = ptile.GetArrayOfStructs();
 
+        //neighbor copies are refreshed by the next updateNeighbors
         int np = aos.numRealParticles();
-        int ng = aos.numNeighborParticles();
-        int nt = np+ng;
+        if(np==0)
+        {
+            continue;
+        }
 
         ParticleType* pstruct = aos().dataPtr();
 
-        amrex::ParallelFor(nt,[=]
-        AMREX_GPU_DEVICE (int i) noexcept
+        //partition the tile into one index list per model and run each
+        //group through its own kernel
+        for(int model=0;model<NUM_CONSTITUTIVE_MODELS;model++)
         {
-            Real p_inf=0.0;
-            ParticleType& p = pstruct[i];
+            group_index[model].resize(np);
+            int* idx=group_index[model].dataPtr();
 
-            if(p.idata(intData::phase)==0)
+            auto in_group=[=] AMREX_GPU_DEVICE (int i) -> int
             {
-                amrex::Real xp[AMREX_SPACEDIM];
-                amrex::Real strainrate[NCOMP_TENSOR];
-                amrex::Real strain[NCOMP_TENSOR];
-                amrex::Real stress[NCOMP_TENSOR];
-
-                for(int d=0;d<NCOMP_TENSOR;d++)
-                {
-                    p.rdata(realData::strain+d) += dt*p.rdata(realData::strainrate+d);
-                }
-                //apply axial strain
-                p.rdata(realData::strain+XX) += dt*applied_strainrate;
-                p.rdata(realData::strain+YY) += dt*applied_strainrate;
-                p.rdata(realData::strain+ZZ) += dt*applied_strainrate;
-
-                for(int d=0;d<NCOMP_TENSOR;d++)
-                {
-                    strainrate[d]=p.rdata(realData::strainrate+d);
-                    strain[d]=p.rdata(realData::strain+d);
-                }
-
-                if(p.idata(intData::constitutive_model)==0)		//Elastic solid
-                {
-                    linear_elastic(strain,strainrate,stress,p.rdata(realData::E),p.rdata(realData::nu));
-                }
-                else if(p.idata(intData::constitutive_model)==1)		//Viscous fluid with approximate EoS
+                const ParticleType& p = pstruct[i];
+                return(p.idata(intData::phase)==0 &&
+                       p.idata(intData::constitutive_model)==model &&
+                       p.idata(intData::dt_level)>=kmin);
+            };
+
+            int ngroup=Scan::PrefixSum<int>(np,
+            [=] AMREX_GPU_DEVICE (int i) -> int
+            {
+                return(in_group(i));
+            },
+            [=] AMREX_GPU_DEVICE (int i, int const& s)
+            {
+                if(in_group(i))
                 {
-                    p.rdata(realData::pressure) = p.rdata(realData::Bulk_modulus)*
-                    (pow(1/p.rdata(realData::jacobian),p.rdata(realData::Gama_pressure))-1.0)+p_inf;
-                    Newtonian_Fluid(strainrate,stress,p.rdata(realData::Dynamic_viscosity),p.rdata(realData::pressure));
+                    idx[s]=i;
                 }
+            },
+            Scan::Type::exclusive,Scan::retSum);
 
-                for(int d=0;d<NCOMP_TENSOR;d++)
-                {
-                    p.rdata(realData::stress+d)=stress[d];
-                }
+            if(ngroup>0)
+            {
+                ConstitutiveDispatch<0>::apply(model,pstruct,idx,ngroup,dt,nlev,
+                                               applied_strainrate,delta_form,eos);
             }
-        });
+        }
     }
-} 
+    Gpu::streamSynchronize();
+}
 
-void MPMParticleContainer::apply_constitutive_model_delta(const amrex::Real& dt,
-                                                          amrex::Real applied_strainrate=0.0)
+EOSTableView MPMParticleContainer::eos_table_view() const
 {
-    const int lev = 0;
-    const Geometry& geom = Geom(lev);
-    auto& plev  = GetParticles(lev);
-    const auto dxi = geom.InvCellSizeArray();
-    const auto dx = geom.CellSizeArray();
-    const auto plo = geom.ProbLoArray();
-    const auto domain = geom.Domain();
-
-    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    EOSTableView eos;
+    if(!eos_table_data.empty())
     {
-        const amrex::Box& box = mfi.tilebox();
-        int gid = mfi.index();
-        int tid = mfi.LocalTileIndex();
-        auto index = std::make_pair(gid, tid);
-        Real pinf=0.0;
+        eos.data=eos_table_data.dataPtr();
+        eos.n=static_cast<int>(eos_table_data.size());
+        eos.jmin=eos_table_jmin;
+        eos.jmax=eos_table_jmax;
+        eos.dj_inv=(eos.n-1)/(eos_table_jmax-eos_table_jmin);
+        eos.gamma=eos_table_gamma;
+    }
+    return(eos);
+}
 
-        auto& ptile = plev[index];
-        auto& aos   = ptile.GetArrayOfStructs();
+void MPMParticleContainer::build_eos_table(int npoints,amrex::Real jmin,amrex::Real jmax)
+{
+    BL_PROFILE("MPMParticleContainer::build_eos_table");
 
-        int np = aos.numRealParticles();
-        int ng = aos.numNeighborParticles();
-        int nt = np+ng;
+    eos_table_data.clear();
+    if(npoints<2)
+    {
+        return;
+    }
 
-        ParticleType* pstruct = aos().dataPtr();
+    //one exponent is tabulated, so all fluid points have to share it
+    using PType = typename MPMParticleContainer::SuperParticleType;
+    Real gmin = amrex::ReduceMin(*this, [=]
+    AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+    {
+        return((p.idata(intData::phase)==0 && p.idata(intData::constitutive_model)==1)?
+               p.rdata(realData::Gama_pressure):std::numeric_limits<Real>::max());
+    });
+    Real gmax = amrex::ReduceMax(*this, [=]
+    AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+    {
+        return((p.idata(intData::phase)==0 && p.idata(intData::constitutive_model)==1)?
+               p.rdata(realData::Gama_pressure):std::numeric_limits<Real>::lowest());
+    });
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealMin(gmin);
+    ParallelDescriptor::ReduceRealMax(gmax);
+#endif
+
+    if(gmin>gmax)
+    {
+        return;
+    }
+    if(gmin!=gmax)
+    {
+        amrex::Print()<<"\nFluid points use different EOS exponents, the EOS table is not used";
+        return;
+    }
 
-        amrex::ParallelFor(nt,[=]
-        AMREX_GPU_DEVICE (int i) noexcept
-        {
-            Real p_inf=0.0;
-            ParticleType& p = pstruct[i];
+    eos_table_jmin=jmin;
+    eos_table_jmax=jmax;
+    eos_table_gamma=gmin;
 
-            if(p.idata(intData::phase)==0)
-            {
-				amrex::Real xp[AMREX_SPACEDIM];
-				amrex::Real strainrate[NCOMP_TENSOR];
-				amrex::Real delta_strain[NCOMP_TENSOR];
-				amrex::Real delta_stress[NCOMP_TENSOR];
-
-				for(int d=0;d<NCOMP_TENSOR;d++)
-				{
-					p.rdata(realData::strain+d) += dt*p.rdata(realData::strainrate+d);
-				}
-				//apply axial strain
-				p.rdata(realData::strain+XX) += dt*applied_strainrate;
-				p.rdata(realData::strain+YY) += dt*applied_strainrate;
-				p.rdata(realData::strain+ZZ) += dt*applied_strainrate;
-
-				for(int d=0;d<NCOMP_TENSOR;d++)
-				{
-					delta_strain[d]=dt*p.rdata(realData::strainrate+d);
-				}
-
-				//apply axial strain
-				delta_strain[XX] += dt*applied_strainrate;
-				delta_strain[YY] += dt*applied_strainrate;
-				delta_strain[ZZ] += dt*applied_strainrate;
-
-				if(p.idata(intData::constitutive_model)==0)		//Elastic solid
-				{
-					linear_elastic(delta_strain,delta_stress,p.rdata(realData::E),p.rdata(realData::nu));
-				}
-				else if(p.idata(intData::constitutive_model)==1)		//Viscous fluid with approximate EoS
-				{
-					amrex::Abort("\nDelta strain model for weakly compressible fluids not implemented yet.");
-				}
-
-				for(int d=0;d<NCOMP_TENSOR;d++)
-				{
-					p.rdata(realData::stress+d)+=delta_stress[d];
-				}
-            }
-        });
+    Gpu::HostVector<Real> table(npoints);
+    Real dj=(jmax-jmin)/(npoints-1);
+    for(int i=0;i<npoints;i++)
+    {
+        table[i]=std::pow(one/(jmin+i*dj),gmin)-one;
     }
+    eos_table_data.resize(npoints);
+    Gpu::copy(Gpu::hostToDevice,table.begin(),table.end(),eos_table_data.begin());
 }
-
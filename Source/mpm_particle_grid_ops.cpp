@@ -1,5 +1,6 @@
 #include <mpm_particle_container.H>
 #include <interpolants.H>
+#include <nodal_data_ops.H>
 
 int MPMParticleContainer::checkifrigidnodespresent()
 {
@@ -30,69 +31,121 @@ int MPMParticleContainer::checkifrigidnodespresent()
 
 }
 
-void MPMParticleContainer::Calculate_Total_Number_of_rigid_particles(int body_id,int &total_num)
+//Rigid-body ids run from 0 to the returned count-1
+int MPMParticleContainer::Calculate_Number_of_RigidBodies()
 {
-    const int lev = 0;
-    const Geometry& geom = Geom(lev);
-    auto& plev  = GetParticles(lev);
-    const auto dxi = geom.InvCellSizeArray();
-    const auto dx = geom.CellSizeArray();
-    const auto plo = geom.ProbLoArray();
-    const auto domain = geom.Domain();
-
-    total_num=0;
-
-    using PType = typename MPMParticleContainer::SuperParticleType;
-    total_num = amrex::ReduceSum(*this, [=]
-        AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
-        {
-    		if(p.idata(intData::phase)==1 and p.idata(intData::rigid_body_id)==body_id)
-    		{
-    			return(1);
-    		}
-    		else
-    		{
-    			return(0);
-    		}
-        });
+	using PType = typename MPMParticleContainer::SuperParticleType;
+	int maxid = amrex::ReduceMax(*this, [=]
+	    AMREX_GPU_HOST_DEVICE (const PType& p) -> int
+	    {
+	        return((p.idata(intData::phase)==1)?p.idata(intData::rigid_body_id):-1);
+	    });
 
 	#ifdef BL_USE_MPI
-	    ParallelDescriptor::ReduceIntSum(total_num);
+	    ParallelDescriptor::ReduceIntMax(maxid);
 	#endif
+	return(maxid+1);
 }
 
-void MPMParticleContainer::Calculate_Total_Number_of_MaterialParticles(int &total_num)
+//Number, mass, volume, centre of mass and inertia of the rigid particles of
+//every body in one sweep
+void MPMParticleContainer::Calculate_RigidBody_Totals(amrex::Vector<Rigid_Bodies> &Rb)
 {
+    BL_PROFILE("MPMParticleContainer::Calculate_RigidBody_Totals");
+
     const int lev = 0;
-    const Geometry& geom = Geom(lev);
     auto& plev  = GetParticles(lev);
-    const auto dxi = geom.InvCellSizeArray();
-    const auto dx = geom.CellSizeArray();
-    const auto plo = geom.ProbLoArray();
-    const auto domain = geom.Domain();
+    const int nbodies=Rb.size();
 
-    total_num=0;
+    //count, mass, volume, first moments (3), second moments (6), own inertia of the spheres
+    const int nsum=13;
+    Gpu::DeviceVector<amrex::Real> sums(nsum*nbodies,zero);
+    amrex::Real* sumptr=sums.dataPtr();
 
-    using PType = typename MPMParticleContainer::SuperParticleType;
-    total_num = amrex::ReduceSum(*this, [=]
-        AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
         {
-    		if(p.idata(intData::phase)==0)
-    		{
-    			return(1);
-    		}
-    		else
-    		{
-    			return(0);
-    		}
+            ParticleType& p = pstruct[i];
+            int b=p.idata(intData::rigid_body_id);
+            if(p.idata(intData::phase)==1 && b>=0 && b<nbodies)
+            {
+                amrex::Real* bsum=sumptr+nsum*b;
+                const amrex::Real m=p.rdata(realData::mass);
+                const amrex::Real r=p.rdata(realData::radius);
+                Gpu::Atomic::AddNoRet(&bsum[0],one);
+                Gpu::Atomic::AddNoRet(&bsum[1],m);
+                Gpu::Atomic::AddNoRet(&bsum[2],p.rdata(realData::volume));
+                int ind=6;
+                for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+                {
+                    Gpu::Atomic::AddNoRet(&bsum[3+d1],m*p.pos(d1));
+                    for(int d2=d1;d2<AMREX_SPACEDIM;d2++)
+                    {
+                        Gpu::Atomic::AddNoRet(&bsum[ind],m*p.pos(d1)*p.pos(d2));
+                        ind++;
+                    }
+                }
+                Gpu::Atomic::AddNoRet(&bsum[12],twobyfive*m*r*r);
+            }
         });
+    }
 
-	#ifdef BL_USE_MPI
-	    ParallelDescriptor::ReduceIntSum(total_num);
-	#endif
+    amrex::Vector<amrex::Real> hsums(nsum*nbodies);
+    Gpu::copy(Gpu::deviceToHost,sums.begin(),sums.end(),hsums.begin());
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealSum(hsums.dataPtr(),hsums.size());
+#endif
+
+    for(int b=0;b<nbodies;b++)
+    {
+        const amrex::Real* bsum=&hsums[nsum*b];
+        Rb[b].num_of_mp=static_cast<int>(bsum[0]+half);
+        Rb[b].total_mass=bsum[1];
+        Rb[b].total_volume=bsum[2];
+        if(bsum[1]<=zero)
+        {
+            continue;
+        }
+
+        //second moments about the centre of mass
+        amrex::Real S[AMREX_SPACEDIM][AMREX_SPACEDIM];
+        int ind=6;
+        for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+        {
+            Rb[b].center[d1]=bsum[3+d1]/bsum[1];
+        }
+        for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+        {
+            for(int d2=d1;d2<AMREX_SPACEDIM;d2++)
+            {
+                S[d1][d2]=bsum[ind]-bsum[1]*Rb[b].center[d1]*Rb[b].center[d2];
+                S[d2][d1]=S[d1][d2];
+                ind++;
+            }
+        }
+        amrex::Real trace=S[XDIR][XDIR]+S[YDIR][YDIR]+S[ZDIR][ZDIR];
+        for(int d1=0;d1<AMREX_SPACEDIM;d1++)
+        {
+            for(int d2=0;d2<AMREX_SPACEDIM;d2++)
+            {
+                Rb[b].inertia[d1][d2]=((d1==d2)?trace+bsum[12]:zero)-S[d1][d2];
+            }
+        }
+    }
 }
 
-void MPMParticleContainer::Calculate_Total_Mass_RigidParticles(int body_id,Real &total_mass)
+void MPMParticleContainer::Calculate_Total_Number_of_MaterialParticles(int &total_num)
 {
     const int lev = 0;
     const Geometry& geom = Geom(lev);
@@ -102,24 +155,24 @@ void MPMParticleContainer::Calculate_Total_Mass_RigidParticles(int body_id,Real
     const auto plo = geom.ProbLoArray();
     const auto domain = geom.Domain();
 
-    total_mass=0.0;
+    total_num=0;
 
     using PType = typename MPMParticleContainer::SuperParticleType;
-    total_mass = amrex::ReduceSum(*this, [=]
+    total_num = amrex::ReduceSum(*this, [=]
         AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
         {
-    		if(p.idata(intData::phase)==1 and p.idata(intData::rigid_body_id)==body_id)
+    		if(p.idata(intData::phase)==0 && p.id()>=0)
     		{
-    			return(p.rdata(realData::mass));
+    			return(1);
     		}
     		else
     		{
-    			return(0.0);
+    			return(0);
     		}
         });
 
 	#ifdef BL_USE_MPI
-	    ParallelDescriptor::ReduceRealSum(total_mass);
+	    ParallelDescriptor::ReduceIntSum(total_num);
 	#endif
 }
 
@@ -185,33 +238,6 @@ void MPMParticleContainer::Calculate_Total_Vol_MaterialPoints(Real &total_vol)
 	#endif
 }
 
-amrex::Real MPMParticleContainer::Calculate_Total_Vol_RigidParticles(int body_id)
-{
-
-	amrex::Real total_vol=0.0;
-	const int lev = 0;
-	auto& plev  = GetParticles(lev);
-
-	using PType = typename MPMParticleContainer::SuperParticleType;
-	total_vol = amrex::ReduceSum(*this, [=]
-	    AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
-	    {
-			if(p.idata(intData::phase)==1 and  p.idata(intData::rigid_body_id)==body_id)
-	        {
-	        	return(p.rdata(realData::volume));
-	        }
-			else
-			{
-				return(0.0);
-			}
-	    });
-
-	#ifdef BL_USE_MPI
-	    ParallelDescriptor::ReduceRealSum(total_vol);
-	#endif
-	return(total_vol);
-}
-
 void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
                                              Array<Real,AMREX_SPACEDIM> gravity,
                                              int external_loads_present,
@@ -222,7 +248,8 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
 				             				 int update_forces,
 					 						 amrex::Real mass_tolerance,
 					     					 GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
-											 GpuArray<int,AMREX_SPACEDIM> periodic)
+											 GpuArray<int,AMREX_SPACEDIM> periodic,
+											 MultiFab* stressdata)
 {
     const int lev = 0;
     const Geometry& geom = Geom(lev);
@@ -233,6 +260,11 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
     const auto domain = geom.Domain();
     int extloads=external_loads_present;
 
+    if(update_forces==2 && stressdata==nullptr)
+    {
+        amrex::Abort("\nNodal stress deposition needs the stress nodal state");
+    }
+
     Real grav[]={AMREX_D_DECL(gravity[XDIR],gravity[YDIR],gravity[ZDIR])};
     Real slab_lo[]={AMREX_D_DECL(force_slab_lo[XDIR],force_slab_lo[YDIR],force_slab_lo[ZDIR])};
     Real slab_hi[]={AMREX_D_DECL(force_slab_hi[XDIR],force_slab_hi[YDIR],force_slab_hi[ZDIR])};
@@ -244,12 +276,52 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
     int lo[]={loarr[0],loarr[1],loarr[2]};
     int hi[]={hiarr[0],hiarr[1],hiarr[2]};
 
+    const int nlev=mr_nlevels;
+    const bool use_force_cache=(update_forces && nlev>1);
+    if(use_force_cache && (!mr_force_cache.ok() || mr_force_cache.nComp()!=AMREX_SPACEDIM*nlev ||
+                           mr_force_cache.boxArray()!=nodaldata.boxArray()))
+    {
+        mr_force_cache.define(nodaldata.boxArray(),nodaldata.DistributionMap(),AMREX_SPACEDIM*nlev,0);
+        mr_force_cache_stale=true;
+    }
+    //after a re-binning the per-level sums belong to the old levels, so
+    //every level deposits afresh and refills its cache entry
+    const int kmin=(use_force_cache && mr_force_cache_stale)?0:mr_min_active_level;
+    if(use_force_cache)
+    {
+        mr_force_cache.setVal(zero,AMREX_SPACEDIM*kmin,AMREX_SPACEDIM*(nlev-kmin),0);
+        mr_force_cache_stale=false;
+    }
+
+    //sleeping particles deposit only to rebuild their cached contribution
+    const int nsleep=sleep_after;
+    if(nsleep>0 && (!sleep_cache.ok() || sleep_cache.boxArray()!=nodaldata.boxArray()))
+    {
+        sleep_cache.define(nodaldata.boxArray(),nodaldata.DistributionMap(),FRCZ_INDEX+1,0);
+        sleep_cache.setVal(zero);
+        sleep_cache_valid=0;
+    }
+    const int rebuild_massvel=(nsleep>0 && update_massvel && !(sleep_cache_valid&1));
+    const int rebuild_forces=(nsleep>0 && update_forces && !(sleep_cache_valid&2));
+    if(nsleep>0)
+    {
+        if(rebuild_massvel)
+        {
+            sleep_cache.setVal(zero,MASS_INDEX,AMREX_SPACEDIM+1,0);
+        }
+        if(rebuild_forces)
+        {
+            sleep_cache.setVal(zero,FRCX_INDEX,AMREX_SPACEDIM,0);
+        }
+    }
+
     for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
     {
         //already nodal as mfi is from nodaldata
         const Box& nodalbox=mfi.validbox();
 
         Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> stress_arr=(update_forces==2)?stressdata->array(mfi):Array4<Real>();
 
         amrex::ParallelFor(nodalbox,[=]
         AMREX_GPU_DEVICE (int i,int j,int k) noexcept
@@ -269,11 +341,16 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             }
             if(update_forces==2)
             {
-            	nodal_data_arr(i,j,k,STRESS_INDEX)=zero;
+            	stress_arr(i,j,k,STRESS_INDEX)=zero;
             }
         });
     }
 
+    //multi-field contact: the bodies present at the tile nodes and their
+    //gather ghosts are ORed in the same pass as the mass
+    const bool build_mask=(mfc_enabled && update_massvel);
+    const IntVect ng_mask=(build_mask)?nodal_gather_ghosts(order_scheme_directional,gather_drift_cells):IntVect(0);
+
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
         const amrex::Box& box = mfi.tilebox();
@@ -290,6 +367,19 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
         int nt = np+ng;
 
         Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> stress_arr=(update_forces==2)?stressdata->array(mfi):Array4<Real>();
+        Array4<Real> cache_arr=(use_force_cache)?mr_force_cache.array(mfi):Array4<Real>();
+        Array4<Real> sleep_arr=(nsleep>0)?sleep_cache.array(mfi):Array4<Real>();
+
+        const Box mask_region=amrex::grow(nodalbox,ng_mask);
+        Array4<int> mask_arr;
+        if(build_mask)
+        {
+            ContactFieldTile& cft=mfc_tiles[index];
+            cft.mask.resize(mask_region,1);
+            cft.mask.setVal<RunOn::Device>(0);
+            mask_arr=cft.mask.array();
+        }
 
         ParticleType* pstruct = aos().dataPtr();
     
@@ -301,7 +391,13 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
 
             ParticleType& p = pstruct[i];
 
-            if(p.idata(intData::phase)==0)		//Compute only for standard particles and not rigid particles with phase=1
+            const bool asleep=(nsleep>0 && p.idata(intData::quiet_steps)>=nsleep);
+            const bool dep_massvel=(update_massvel && (!asleep || rebuild_massvel));
+            const bool dep_forces=(update_forces && (!asleep || rebuild_forces));
+            Array4<Real> const& dst=(asleep)?sleep_arr:nodal_data_arr;
+
+            if(p.idata(intData::phase)==0 && p.id()>=0 &&
+               (dep_massvel || dep_forces || update_forces==2))		//Compute only for standard particles and not rigid particles with phase=1
             {
 
             	amrex::Real xp[AMREX_SPACEDIM];
@@ -312,6 +408,11 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
 
             	auto iv = getParticleCell(p, plo, dxi, domain);
 
+            	//inactive multi-rate levels take their internal force from the
+            	//cache, so only body and external forces are deposited for them
+            	const int plevel=(use_force_cache)?p.idata(intData::dt_level):0;
+            	const bool live_stress=(!use_force_cache || plevel>=kmin);
+
             	lmin=(order_scheme_directional[0]==1)?0:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?0:((iv[XDIR]==hi[XDIR])?-1:-1):-1000);
             	lmax=(order_scheme_directional[0]==1)?2:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?lmin+3:((iv[XDIR]==hi[XDIR])?lmin+3:lmin+4):-1000);
 
@@ -335,6 +436,11 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             			{
             				IntVect ivlocal(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n);
 
+            				if(build_mask && mask_region.contains(ivlocal))
+            				{
+            					amrex::Gpu::Atomic::Or(&mask_arr(ivlocal),1<<p.idata(intData::contact_field));
+            				}
+
             				if(iv[YDIR]+m==lo[1] && iv[XDIR]+l==25 && iv[ZDIR]+n==25)
             				//if(iv[XDIR]+l==25 && iv[ZDIR]+n==25)
             				{
@@ -344,7 +450,7 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             				{
             					amrex::Real basisvalue=basisval(l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
 
-            					if(update_massvel)
+            					if(dep_massvel)
             					{
             						amrex::Real mass_contrib=p.rdata(realData::mass)*basisvalue;
             						amrex::Real p_contrib[AMREX_SPACEDIM] =
@@ -352,26 +458,16 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
                                      p.rdata(realData::mass)*p.rdata(realData::yvel)*basisvalue,
                                      p.rdata(realData::mass)*p.rdata(realData::zvel)*basisvalue};
 
-            						amrex::Gpu::Atomic::AddNoRet(&nodal_data_arr(ivlocal,MASS_INDEX), mass_contrib);
+            						amrex::Gpu::Atomic::AddNoRet(&dst(ivlocal,MASS_INDEX), mass_contrib);
 
             						for(int dim=0;dim<AMREX_SPACEDIM;dim++)
             						{
-            							amrex::Gpu::Atomic::AddNoRet(&nodal_data_arr(ivlocal,VELX_INDEX+dim),p_contrib[dim]);
+            							amrex::Gpu::Atomic::AddNoRet(&dst(ivlocal,VELX_INDEX+dim),p_contrib[dim]);
             						}
             					}
 
-            					if(update_forces)
+            					if(dep_forces)
             					{
-            						amrex::Real basisval_grad[AMREX_SPACEDIM];
-            						amrex::Real stress_tens[AMREX_SPACEDIM*AMREX_SPACEDIM];
-
-            						get_tensor(p,realData::stress,stress_tens);
-
-            						for(int d=0;d<AMREX_SPACEDIM;d++)
-            						{
-            							basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
-            						}
-
             						amrex::Real bforce_contrib[AMREX_SPACEDIM]=
             						{   p.rdata(realData::mass)*grav[XDIR]*basisvalue,
             							p.rdata(realData::mass)*grav[YDIR]*basisvalue,
@@ -387,18 +483,41 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             							bforce_contrib[ZDIR] += extpforce[ZDIR]*basisvalue;
             						}
 
-            						amrex::Real tensvect[AMREX_SPACEDIM];
-            						tensor_vector_pdt(stress_tens,basisval_grad,tensvect);
-
-            						amrex::Real intforce_contrib[AMREX_SPACEDIM]=
-            						{	-p.rdata(realData::volume)*tensvect[XDIR],
-            							-p.rdata(realData::volume)*tensvect[YDIR],
-										-p.rdata(realData::volume)*tensvect[ZDIR]};
+            						amrex::Real intforce_contrib[AMREX_SPACEDIM]={AMREX_D_DECL(zero,zero,zero)};
+            						if(live_stress)
+            						{
+            							amrex::Real basisval_grad[AMREX_SPACEDIM];
+            							amrex::Real stress_tens[AMREX_SPACEDIM*AMREX_SPACEDIM];
+
+            							get_tensor(p,realData::stress,stress_tens);
+
+            							for(int d=0;d<AMREX_SPACEDIM;d++)
+            							{
+            								basisval_grad[d]=basisvalder(d,l,m,n,iv[XDIR],iv[YDIR],iv[ZDIR],xp,plo,dx,order_scheme_directional,periodic,lo,hi);
+            							}
+
+            							amrex::Real tensvect[AMREX_SPACEDIM];
+            							tensor_vector_pdt(stress_tens,basisval_grad,tensvect);
+
+            							for(int dim=0;dim<AMREX_SPACEDIM;dim++)
+            							{
+            								intforce_contrib[dim]=-p.rdata(realData::volume)*tensvect[dim];
+            							}
+
+            							if(use_force_cache)
+            							{
+            								for(int dim=0;dim<AMREX_SPACEDIM;dim++)
+            								{
+            									amrex::Gpu::Atomic::AddNoRet(&cache_arr(ivlocal,AMREX_SPACEDIM*plevel+dim),
+            																 intforce_contrib[dim]);
+            								}
+            							}
+            						}
 
             						for(int dim=0;dim<AMREX_SPACEDIM;dim++)
             						{
             							amrex::Gpu::Atomic::AddNoRet(
-            									&nodal_data_arr(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n,FRCX_INDEX+dim),
+            									&dst(iv[XDIR]+l,iv[YDIR]+m,iv[ZDIR]+n,FRCX_INDEX+dim),
 												bforce_contrib[dim]+intforce_contrib[dim]);
             						}
             					}
@@ -406,7 +525,7 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             					if(update_forces==2)
             					{
             						amrex::Real stress_contrib=p.rdata(realData::stress+3)*p.rdata(realData::mass)*basisvalue;
-            						amrex::Gpu::Atomic::AddNoRet(&nodal_data_arr(ivlocal,STRESS_INDEX), stress_contrib);
+            						amrex::Gpu::Atomic::AddNoRet(&stress_arr(ivlocal,STRESS_INDEX), stress_contrib);
             					}
             				} //nodalbox if loop
             			} //l loop
@@ -416,6 +535,27 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
         });
 
     }
+
+    if(use_force_cache)
+    {
+        for(int k=0;k<kmin;k++)
+        {
+            MultiFab::Add(nodaldata,mr_force_cache,AMREX_SPACEDIM*k,FRCX_INDEX,AMREX_SPACEDIM,0);
+        }
+    }
+    if(nsleep>0)
+    {
+        if(update_massvel)
+        {
+            MultiFab::Add(nodaldata,sleep_cache,MASS_INDEX,MASS_INDEX,AMREX_SPACEDIM+1,0);
+            sleep_cache_valid|=1;
+        }
+        if(update_forces)
+        {
+            MultiFab::Add(nodaldata,sleep_cache,FRCX_INDEX,FRCX_INDEX,AMREX_SPACEDIM,0);
+            sleep_cache_valid|=2;
+        }
+    }
     //nodaldata.FillBoundary(geom.periodicity());
     //nodaldata.SumBoundary(geom.periodicity());
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
@@ -434,6 +574,7 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
         int nt = np+ng;
 
         Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> stress_arr=(update_forces==2)?stressdata->array(mfi):Array4<Real>();
 
         amrex::ParallelFor(
         nodalbox, [=] AMREX_GPU_DEVICE(int i, int j, int k) noexcept 
@@ -462,11 +603,11 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
             	{
             		if(nodal_data_arr(i,j,k,MASS_INDEX)>=mass_tolerance)
             		{
-            			nodal_data_arr(i,j,k,STRESS_INDEX)/=nodal_data_arr(i,j,k,MASS_INDEX);
+            			stress_arr(i,j,k,STRESS_INDEX)/=nodal_data_arr(i,j,k,MASS_INDEX);
             		}
             		else
             		{
-            			nodal_data_arr(i,j,k,STRESS_INDEX) = 0.0;
+            			stress_arr(i,j,k,STRESS_INDEX) = 0.0;
             		}
             	}
             }
@@ -479,7 +620,7 @@ void MPMParticleContainer::deposit_onto_grid(MultiFab& nodaldata,
 
 
 
-void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& nodaldata,
+void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& rigiddata,
                                              Array<Real,AMREX_SPACEDIM> gravity,
                                              int external_loads_present,
                                              Array<Real,AMREX_SPACEDIM> force_slab_lo,
@@ -509,12 +650,12 @@ void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& nodaldata,
     int lo[]={loarr[0],loarr[1],loarr[2]};
     int hi[]={hiarr[0],hiarr[1],hiarr[2]};
 
-    for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    for (MFIter mfi(rigiddata); mfi.isValid(); ++mfi)
     {
-    	//already nodal as mfi is from nodaldata
+    	//already nodal as mfi is from rigiddata
     	const Box& nodalbox=mfi.validbox();
 
-    	Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+    	Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
     	amrex::ParallelFor(nodalbox,[=]
 			AMREX_GPU_DEVICE (int i,int j,int k) noexcept
@@ -538,7 +679,7 @@ void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& nodaldata,
         int ng =aos.numNeighborParticles();
         int nt = np+ng;
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
         ParticleType* pstruct = aos().dataPtr();
 
@@ -610,8 +751,8 @@ void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& nodaldata,
         });
 
     }
-    //nodaldata.FillBoundary(geom.periodicity());
-    //nodaldata.SumBoundary(geom.periodicity());
+    //rigiddata.FillBoundary(geom.periodicity());
+    //rigiddata.SumBoundary(geom.periodicity());
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
         const amrex::Box& box = mfi.tilebox();
@@ -627,7 +768,7 @@ void MPMParticleContainer::deposit_onto_grid_rigidnodesonly(MultiFab& nodaldata,
         int ng =aos.numNeighborParticles();
         int nt = np+ng;
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
         amrex::ParallelFor(
         nodalbox, [=] AMREX_GPU_DEVICE(int i, int j, int k) noexcept
@@ -678,8 +819,15 @@ void MPMParticleContainer::interpolate_from_grid(MultiFab& nodaldata,int update_
     int lo[]={loarr[0],loarr[1],loarr[2]};
     int hi[]={hiarr[0],hiarr[1],hiarr[2]};
     const double pi = 3.141592654;
+    const int nlev=mr_nlevels;
+    const int kmin=mr_min_active_level;
 
-    nodaldata.FillBoundary(geom.periodicity());
+    const IntVect ng_gather=nodal_gather_ghosts(order_scheme_directional,gather_drift_cells);
+    fill_nodal_ghosts(nodaldata,geom,VELX_INDEX,AMREX_SPACEDIM,ng_gather);
+    if(update_vel)
+    {
+        fill_nodal_ghosts(nodaldata,geom,DELTA_VELX_INDEX,AMREX_SPACEDIM,ng_gather);
+    }
 
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
@@ -781,7 +929,7 @@ void MPMParticleContainer::interpolate_from_grid(MultiFab& nodaldata,int update_
 					}
 				}
 
-				if(update_strainrate)
+				if(update_strainrate && p.idata(intData::dt_level)>=kmin)
 				{
 					for(int n=nmin;n<nmax;n++)
 					{
@@ -812,7 +960,8 @@ void MPMParticleContainer::interpolate_from_grid(MultiFab& nodaldata,int update_
 					}
 
 					//Calculate deformation gradient tensor at time t+dt
-					get_deformation_gradient_tensor(p,realData::deformation_gradient,gradvp,dt);
+					get_deformation_gradient_tensor(p,realData::deformation_gradient,gradvp,
+					                                dt*(1<<(nlev-1-p.idata(intData::dt_level))));
 
 					int ind=0;
 					for(int d1=0;d1<AMREX_SPACEDIM;d1++)
@@ -830,7 +979,7 @@ void MPMParticleContainer::interpolate_from_grid(MultiFab& nodaldata,int update_
 }
 
 
-void MPMParticleContainer::calculate_nodal_normal	(MultiFab& nodaldata,
+void MPMParticleContainer::calculate_nodal_normal	(MultiFab& rigiddata,
 														 amrex::Real mass_tolerance,
 														 GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
 														 GpuArray<int,AMREX_SPACEDIM> periodic)
@@ -849,11 +998,11 @@ void MPMParticleContainer::calculate_nodal_normal	(MultiFab& nodaldata,
     int lo[]={loarr[0],loarr[1],loarr[2]};
     int hi[]={hiarr[0],hiarr[1],hiarr[2]};
 
-    for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    for (MFIter mfi(rigiddata); mfi.isValid(); ++mfi)
     {
         const Box& nodalbox=mfi.validbox();
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
         amrex::ParallelFor(nodalbox,[=]
         AMREX_GPU_DEVICE (int i,int j,int k) noexcept
@@ -879,7 +1028,7 @@ void MPMParticleContainer::calculate_nodal_normal	(MultiFab& nodaldata,
         int ng =aos.numNeighborParticles();
         int nt = np+ng;
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
         ParticleType* pstruct = aos().dataPtr();
 
@@ -962,7 +1111,7 @@ void MPMParticleContainer::calculate_nodal_normal	(MultiFab& nodaldata,
         int ng =aos.numNeighborParticles();
         int nt = np+ng;
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real> nodal_data_arr=rigiddata.array(mfi);
 
         amrex::ParallelFor(
         nodalbox, [=] AMREX_GPU_DEVICE(int i, int j, int k) noexcept
@@ -2,8 +2,24 @@
 #include <interpolants.H>
 #include <AMReX_PlotFileUtil.H>
 #include <AMReX_AmrMesh.H>
+#include <AMReX_Utility.H>
+#include <mpm_vtk.H>
+#include <algorithm>
 
-void MPMParticleContainer::update_phase_field(MultiFab& phasedata,int refratio,Real smoothfactor)
+void MPMParticleContainer::update_phase_field(MultiFab& phasedata,int refratio,Real smoothfactor,int kernel_type)
+{
+    BL_PROFILE("MPMParticleContainer::update_phase_field");
+    if(kernel_type==0)
+    {
+        update_phase_field_boxkernel(phasedata,refratio,smoothfactor);
+    }
+    else
+    {
+        update_phase_field_separable(phasedata,refratio,smoothfactor);
+    }
+}
+
+void MPMParticleContainer::update_phase_field_boxkernel(MultiFab& phasedata,int refratio,Real smoothfactor)
 {
     int ng_phase=3;
     phasedata.setVal(zero,ng_phase);
@@ -91,7 +107,7 @@ void MPMParticleContainer::update_phase_field(MultiFab& phasedata,int refratio,R
 
     }
 
-    phasedata.SumBoundary(geom.periodicity());
+    phasedata.SumBoundary(geom.periodicity(domain));
     
     //set maximum value to 1
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
@@ -111,81 +127,497 @@ void MPMParticleContainer::update_phase_field(MultiFab& phasedata,int refratio,R
     }
 }
 
-void MPMParticleContainer::writeParticles(std::string prefix_particlefilename, int num_of_digits_in_filenames, const int n)
+void MPMParticleContainer::update_phase_field_separable(MultiFab& phasedata,int refratio,Real smoothfactor)
 {
-    BL_PROFILE("MPMParticleContainer::writeParticles");
-    const std::string& pltfile = amrex::Concatenate(prefix_particlefilename, n, num_of_digits_in_filenames);
+    int ng_phase=phasedata.nGrow();
+    phasedata.setVal(zero,ng_phase);
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    auto& plev  = GetParticles(lev);
+    GpuArray<Real,AMREX_SPACEDIM> dxi = geom.InvCellSizeArray();
+    const auto plo = geom.ProbLoArray();
+    Box domain = geom.Domain();
+    domain.refine(refratio);
+
+    dxi[XDIR]*=refratio;
+    dxi[YDIR]*=refratio;
+    dxi[ZDIR]*=refratio;
+    amrex::Real cellvolinv=dxi[XDIR]*dxi[YDIR]*dxi[ZDIR];
+
+    //Step 1: cloud-in-cell deposition of particle volume fraction on the refined grid
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        amrex::Box box = mfi.tilebox();
+        amrex::Box& refbox = box.refine(refratio);
+        const amrex::Box& refboxgrow = amrex::grow(refbox,ng_phase);
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
 
-    Vector<int> writeflags_real(realData::count,1);
-    Vector<int> writeflags_int(intData::count,0);
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        int np = aos.numRealParticles();
 
+        Array4<Real> phase_data_arr=phasedata.array(mfi);
 
-    Vector<std::string> real_data_names;
-    Vector<std::string>  int_data_names;
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            ParticleType& p = pstruct[i];
+
+            //cell-centred CIC: lower cell index and the weight of the upper cell
+            int ivlo[AMREX_SPACEDIM];
+            amrex::Real wt[AMREX_SPACEDIM];
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                amrex::Real xc=(p.pos(d)-plo[d])*dxi[d]-half;
+                ivlo[d]=static_cast<int>(amrex::Math::floor(xc));
+                wt[d]=xc-ivlo[d];
+            }
+
+            amrex::Real volfrac=p.rdata(realData::volume)*cellvolinv;
+
+            for(int n=0;n<=1;n++)
+            {
+                for(int m=0;m<=1;m++)
+                {
+                    for(int l=0;l<=1;l++)
+                    {
+                        IntVect ivlocal(ivlo[XDIR]+l,ivlo[YDIR]+m,ivlo[ZDIR]+n);
+                        if(refboxgrow.contains(ivlocal))
+                        {
+                            amrex::Real w=((l==0)?(one-wt[XDIR]):wt[XDIR])
+                                         *((m==0)?(one-wt[YDIR]):wt[YDIR])
+                                         *((n==0)?(one-wt[ZDIR]):wt[ZDIR]);
 
-    real_data_names.push_back("radius");
-    real_data_names.push_back("xvel");
-    real_data_names.push_back("yvel");
-    real_data_names.push_back("zvel");
-    real_data_names.push_back("xvel_prime");
-    real_data_names.push_back("yvel_prime");
-    real_data_names.push_back("zvel_prime");
+                            amrex::Gpu::Atomic::AddNoRet(&phase_data_arr(ivlocal),w*volfrac);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    phasedata.SumBoundary(geom.periodicity(domain));
+
+    //Step 2: smooth with a normalised tent kernel, one direction at a time.
+    //The half width follows the largest particle radius, capped by the ghost cells.
+    using PType = typename MPMParticleContainer::SuperParticleType;
+    amrex::Real rmax = amrex::ReduceMax(*this, [=]
+        AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
+        {
+            return(p.rdata(realData::radius));
+        });
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealMax(rmax);
+#endif
+    rmax=amrex::max(rmax,zero);
+
+    int halfwidth=static_cast<int>(std::ceil(smoothfactor*rmax*dxi[XDIR]));
+    halfwidth=amrex::max(1,amrex::min(halfwidth,ng_phase));
+    amrex::Real normfac=one/((halfwidth+1)*(halfwidth+1));
+
+    MultiFab phasetmp(phasedata.boxArray(),phasedata.DistributionMap(),1,ng_phase);
+
+    for(int dir=0;dir<AMREX_SPACEDIM;dir++)
+    {
+        //deposits that landed outside the domain are dropped here
+        phasedata.setBndry(zero);
+        phasedata.FillBoundary(geom.periodicity(domain));
+        MultiFab::Copy(phasetmp,phasedata,0,0,1,ng_phase);
+
+        for(MFIter mfi(phasedata); mfi.isValid(); ++mfi)
+        {
+            const Box& bx=mfi.validbox();
+            Array4<Real> phase_data_arr=phasedata.array(mfi);
+            Array4<Real const> tmp_arr=phasetmp.const_array(mfi);
+
+            amrex::ParallelFor(bx,[=]
+            AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+            {
+                amrex::Real sum=zero;
+                for(int s=-halfwidth;s<=halfwidth;s++)
+                {
+                    int ii=i+((dir==XDIR)?s:0);
+                    int jj=j+((dir==YDIR)?s:0);
+                    int kk=k+((dir==ZDIR)?s:0);
+                    sum+=(halfwidth+1-amrex::Math::abs(s))*tmp_arr(ii,jj,kk);
+                }
+                phase_data_arr(i,j,k)=sum*normfac;
+            });
+        }
+    }
+
+    //set maximum value to 1
+    for(MFIter mfi(phasedata); mfi.isValid(); ++mfi)
+    {
+        const Box& bx=mfi.validbox();
+        Array4<Real> phase_data_arr=phasedata.array(mfi);
+
+        amrex::ParallelFor(bx,[=]
+        AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+        {
+            if(phase_data_arr(i,j,k)>1.0)
+            {
+                phase_data_arr(i,j,k)=1.0;
+            }
+        });
+    }
+}
+
+void get_particle_real_data_names(Vector<std::string> &names)
+{
+    //Names of the particle real data, in realData order
+    names.clear();
+    names.push_back("radius");
+    names.push_back("xvel");
+    names.push_back("yvel");
+    names.push_back("zvel");
+    names.push_back("xvel_prime");
+    names.push_back("yvel_prime");
+    names.push_back("zvel_prime");
     for(int i=0;i<6;i++)
     {
-        real_data_names.push_back(amrex::Concatenate("strainrate_", i, 1));
+        names.push_back(amrex::Concatenate("strainrate_", i, 1));
     }
     for(int i=0;i<6;i++)
     {
-        real_data_names.push_back(amrex::Concatenate("strain_", i, 1));
+        names.push_back(amrex::Concatenate("strain_", i, 1));
     }
     for(int i=0;i<6;i++)
     {
-        real_data_names.push_back(amrex::Concatenate("stress_", i, 1));
+        names.push_back(amrex::Concatenate("stress_", i, 1));
     }
     for(int i=0;i<9;i++)
     {
-    	real_data_names.push_back(amrex::Concatenate("deformationg_gradient_", i, 1));
+    	names.push_back(amrex::Concatenate("deformationg_gradient_", i, 1));
+    }
+    names.push_back("volume");
+    names.push_back("mass");
+    names.push_back("density");
+    names.push_back("jacobian");
+    names.push_back("pressure");
+    names.push_back("vol_init");
+    names.push_back("E");
+    names.push_back("nu");
+    names.push_back("Bulk_modulus");
+    names.push_back("Gama_pressure");
+    names.push_back("Dynamic_viscosity");
+    names.push_back("yacceleration");
+    names.push_back("C01");
+}
+
+void get_particle_int_data_names(Vector<std::string> &names)
+{
+    names.clear();
+    names.push_back("phase");
+    names.push_back("rigid_body_id");
+    names.push_back("constitutive_model");
+    names.push_back("dt_level");
+    names.push_back("contact_field");
+    names.push_back("quiet_steps");
+}
+
+void get_particle_output_flags(const Vector<std::string> &requested,
+                               Vector<int> &writeflags_real,
+                               Vector<int> &writeflags_int)
+{
+    writeflags_real.assign(realData::count,1);
+    writeflags_int.assign(intData::count,0);
+
+    if(requested.empty())
+    {
+        writeflags_int[intData::phase]=1;
+        writeflags_int[intData::constitutive_model]=1;
+        writeflags_int[intData::rigid_body_id]=1;
+
+        writeflags_real[realData::radius]=1;
+        writeflags_real[realData::xvel]=1;
+        writeflags_real[realData::yvel]=1;
+        writeflags_real[realData::zvel]=1;
+        writeflags_real[realData::mass]=1;
+        writeflags_real[realData::jacobian]=1;
+        writeflags_real[realData::pressure]=1;
+        writeflags_real[realData::vol_init]=1;
+        writeflags_real[realData::E]=0;
+        writeflags_real[realData::nu]=0;
+        writeflags_real[realData::Bulk_modulus]=0;
+        writeflags_real[realData::Gama_pressure]=0;
+        writeflags_real[realData::Dynamic_viscosity]=0;
+        return;
+    }
+
+    Vector<std::string> real_data_names;
+    Vector<std::string> int_data_names;
+    get_particle_real_data_names(real_data_names);
+    get_particle_int_data_names(int_data_names);
+
+    writeflags_real.assign(realData::count,0);
+    for(int f=0;f<requested.size();f++)
+    {
+        bool found=false;
+        for(int n=0;n<real_data_names.size();n++)
+        {
+            if(real_data_names[n]==requested[f])
+            {
+                writeflags_real[n]=1;
+                found=true;
+            }
+        }
+        for(int n=0;n<int_data_names.size();n++)
+        {
+            if(int_data_names[n]==requested[f])
+            {
+                writeflags_int[n]=1;
+                found=true;
+            }
+        }
+        if(!found)
+        {
+            amrex::Abort("\nUnknown particle output field "+requested[f]+" in mpm.particle_output_fields");
+        }
     }
-    real_data_names.push_back("volume");
-    real_data_names.push_back("mass");
-    real_data_names.push_back("density");
-    real_data_names.push_back("jacobian");
-    real_data_names.push_back("pressure");
-    real_data_names.push_back("vol_init");
-    real_data_names.push_back("E");
-    real_data_names.push_back("nu");
-    real_data_names.push_back("Bulk_modulus");
-    real_data_names.push_back("Gama_pressure");
-    real_data_names.push_back("Dynamic_viscosity");
-    real_data_names.push_back("yacceleration");
-
-    int_data_names.push_back("phase");
-    int_data_names.push_back("rigid_body_id");
-    int_data_names.push_back("constitutive_model");
-
-
-    writeflags_int[intData::phase]=1;
-    writeflags_int[intData::constitutive_model]=1;
-    writeflags_int[intData::rigid_body_id]=1;
-
-    writeflags_real[realData::radius]=1;
-    writeflags_real[realData::xvel]=1;
-    writeflags_real[realData::yvel]=1;
-    writeflags_real[realData::zvel]=1;
-    writeflags_real[realData::mass]=1;
-    writeflags_real[realData::jacobian]=1;
-    writeflags_real[realData::pressure]=1;
-    writeflags_real[realData::vol_init]=1;
-    writeflags_real[realData::E]=0;
-    writeflags_real[realData::nu]=0;
-    writeflags_real[realData::Bulk_modulus]=0;
-    writeflags_real[realData::Gama_pressure]=0;
-    writeflags_real[realData::Dynamic_viscosity]=0;
+}
+
+void MPMParticleContainer::writeParticles(std::string prefix_particlefilename, int num_of_digits_in_filenames, const int n,
+                                          const Vector<std::string> &output_fields)
+{
+    BL_PROFILE("MPMParticleContainer::writeParticles");
+    const std::string& pltfile = amrex::Concatenate(prefix_particlefilename, n, num_of_digits_in_filenames);
+
+    Vector<int> writeflags_real;
+    Vector<int> writeflags_int;
+    get_particle_output_flags(output_fields,writeflags_real,writeflags_int);
+
+    Vector<std::string> real_data_names;
+    Vector<std::string>  int_data_names;
+
+    get_particle_real_data_names(real_data_names);
+    get_particle_int_data_names(int_data_names);
     
     WritePlotFile(pltfile, "particles",writeflags_real, 
                   writeflags_int, real_data_names, int_data_names);
 }
 
+std::string MPMParticleContainer::writeParticlesVTK(std::string output_folder, std::string prefix_particlefilename,
+                                                    int num_of_digits_in_filenames, const int n,
+                                                    const Vector<std::string> &output_fields)
+{
+    BL_PROFILE("MPMParticleContainer::writeParticlesVTK");
+    const int lev = 0;
+    auto& plev  = GetParticles(lev);
+
+    const std::string pltname = amrex::Concatenate(prefix_particlefilename, n, num_of_digits_in_filenames);
+    const std::string piecedir = pltname+"_vtk/";
+    if(ParallelDescriptor::IOProcessor())
+    {
+        amrex::UtilCreateDirectory(output_folder+piecedir,0755);
+    }
+    ParallelDescriptor::Barrier();
+
+    Vector<int> writeflags_real;
+    Vector<int> writeflags_int;
+    get_particle_output_flags(output_fields,writeflags_real,writeflags_int);
+
+    Vector<std::string> real_data_names;
+    Vector<std::string>  int_data_names;
+    get_particle_real_data_names(real_data_names);
+    get_particle_int_data_names(int_data_names);
+
+    //stage the real particles of this rank in pinned host memory
+    Gpu::PinnedVector<ParticleType> host_particles;
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+        ParticleType* pstruct = aos().dataPtr();
+
+        auto old_size=host_particles.size();
+        host_particles.resize(old_size+np);
+        Gpu::copyAsync(Gpu::deviceToHost,pstruct,pstruct+np,host_particles.begin()+old_size);
+    }
+    Gpu::streamSynchronize();
+
+    //particles removed at outflows wait for the next Redistribute
+    auto last=std::remove_if(host_particles.begin(),host_particles.end(),
+                             [](const ParticleType& p){ return p.id()<0; });
+    host_particles.resize(last-host_particles.begin());
+
+    const std::uint64_t np=host_particles.size();
+
+    std::vector<double> points(3*np);
+    std::vector<std::int64_t> ids(np);
+    std::vector<std::int64_t> connectivity(np);
+    std::vector<std::int64_t> offsets(np);
+    for(std::uint64_t i=0;i<np;i++)
+    {
+        const ParticleType& p=host_particles[i];
+        for(int d=0;d<3;d++)
+        {
+            points[3*i+d]=(d<AMREX_SPACEDIM)?p.pos(d):0.0;
+        }
+        ids[i]=p.id();
+        connectivity[i]=i;
+        offsets[i]=i+1;
+    }
+
+    mpm_vtk::AppendedData data;
+    std::string points_xml=data.add_array("Points","Float64",3,points.data(),points.size()*sizeof(double));
+    std::string verts_xml=data.add_array("connectivity","Int64",1,connectivity.data(),np*sizeof(std::int64_t));
+    verts_xml+=data.add_array("offsets","Int64",1,offsets.data(),np*sizeof(std::int64_t));
+
+    std::string pointdata_xml=data.add_array("id","Int64",1,ids.data(),np*sizeof(std::int64_t));
+    std::string ppointdata_xml="<PDataArray type=\"Int64\" Name=\"id\" NumberOfComponents=\"1\"/>\n";
+
+    std::vector<double> realfield(np);
+    for(int comp=0;comp<realData::count;comp++)
+    {
+        if(!writeflags_real[comp]) continue;
+        for(std::uint64_t i=0;i<np;i++)
+        {
+            realfield[i]=host_particles[i].rdata(comp);
+        }
+        pointdata_xml+=data.add_array(real_data_names[comp],"Float64",1,realfield.data(),np*sizeof(double));
+        ppointdata_xml+="<PDataArray type=\"Float64\" Name=\""+real_data_names[comp]+"\" NumberOfComponents=\"1\"/>\n";
+    }
+
+    std::vector<std::int32_t> intfield(np);
+    for(int comp=0;comp<intData::count;comp++)
+    {
+        if(!writeflags_int[comp]) continue;
+        for(std::uint64_t i=0;i<np;i++)
+        {
+            intfield[i]=host_particles[i].idata(comp);
+        }
+        pointdata_xml+=data.add_array(int_data_names[comp],"Int32",1,intfield.data(),np*sizeof(std::int32_t));
+        ppointdata_xml+="<PDataArray type=\"Int32\" Name=\""+int_data_names[comp]+"\" NumberOfComponents=\"1\"/>\n";
+    }
+
+    //one piece per rank
+    const int myproc=ParallelDescriptor::MyProc();
+    const std::string piecename=piecedir+pltname+"_"+std::to_string(myproc)+".vtp";
+    {
+        std::ofstream ofs(output_folder+piecename,std::ofstream::trunc|std::ofstream::binary);
+        if(!ofs.good())
+        {
+            amrex::FileOpenFailed(output_folder+piecename);
+        }
+        ofs<<mpm_vtk::file_header("PolyData");
+        ofs<<"<PolyData>\n<Piece NumberOfPoints=\""<<np<<"\" NumberOfVerts=\""<<np
+           <<"\" NumberOfLines=\"0\" NumberOfStrips=\"0\" NumberOfPolys=\"0\">\n";
+        ofs<<"<PointData>\n"<<pointdata_xml<<"</PointData>\n";
+        ofs<<"<Points>\n"<<points_xml<<"</Points>\n";
+        ofs<<"<Verts>\n"<<verts_xml<<"</Verts>\n";
+        ofs<<"</Piece>\n</PolyData>\n";
+        data.write(ofs);
+        ofs<<"</VTKFile>\n";
+    }
+
+    if(ParallelDescriptor::IOProcessor())
+    {
+        std::ofstream ofs(output_folder+pltname+".pvtp",std::ofstream::trunc);
+        ofs<<mpm_vtk::file_header("PPolyData");
+        ofs<<"<PPolyData GhostLevel=\"0\">\n";
+        ofs<<"<PPointData>\n"<<ppointdata_xml<<"</PPointData>\n";
+        ofs<<"<PPoints>\n<PDataArray type=\"Float64\" Name=\"Points\" NumberOfComponents=\"3\"/>\n</PPoints>\n";
+        for(int proc=0;proc<ParallelDescriptor::NProcs();proc++)
+        {
+            ofs<<"<Piece Source=\""<<piecedir+pltname+"_"+std::to_string(proc)+".vtp"<<"\"/>\n";
+        }
+        ofs<<mpm_vtk::file_footer("PPolyData");
+    }
+
+    return(pltname+".pvtp");
+}
+
+void MPMParticleContainer::sample_particle_data(const Vector<Long> &ids,
+                                                const Vector<int> &comps,
+                                                Vector<Real> &values)
+{
+    BL_PROFILE("MPMParticleContainer::sample_particle_data");
+    const int lev = 0;
+    auto& plev  = GetParticles(lev);
+
+    int nids=ids.size();
+    int ncomps=comps.size();
+
+    //ids are expected in ascending order for the search below
+    Gpu::DeviceVector<Long> ids_d(nids);
+    Gpu::DeviceVector<int> comps_d(ncomps);
+    Gpu::DeviceVector<Real> values_d(nids*ncomps,zero);
+    Gpu::copy(Gpu::hostToDevice,ids.begin(),ids.end(),ids_d.begin());
+    Gpu::copy(Gpu::hostToDevice,comps.begin(),comps.end(),comps_d.begin());
+
+    const Long* idptr=ids_d.dataPtr();
+    const int* compptr=comps_d.dataPtr();
+    Real* valptr=values_d.dataPtr();
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const int np = aos.numRealParticles();
+
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            ParticleType& p = pstruct[i];
+            Long pid=p.id();
+
+            int left=0;
+            int right=nids-1;
+            int loc=-1;
+            while(left<=right)
+            {
+                int mid=(left+right)/2;
+                if(idptr[mid]==pid)
+                {
+                    loc=mid;
+                    break;
+                }
+                else if(idptr[mid]<pid)
+                {
+                    left=mid+1;
+                }
+                else
+                {
+                    right=mid-1;
+                }
+            }
+
+            if(loc>=0)
+            {
+                for(int n=0;n<ncomps;n++)
+                {
+                    int comp=compptr[n];
+                    valptr[loc*ncomps+n]=(comp>=0)?p.rdata(comp):p.pos(-comp-1);
+                }
+            }
+        });
+    }
+
+    values.resize(nids*ncomps);
+    Gpu::copy(Gpu::deviceToHost,values_d.begin(),values_d.end(),values.begin());
+
+    //each id lives on exactly one rank, so a sum gathers them
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealSum(values.dataPtr(),values.size());
+#endif
+}
+
 void MPMParticleContainer::WriteHeader(const std::string& name, bool is_checkpoint, amrex::Real cur_time, int nstep, int EB_generate_max_level, int output_it) const
 {
     if(ParallelDescriptor::IOProcessor())
@@ -237,46 +669,10 @@ void MPMParticleContainer::writeCheckpointFile(std::string prefix_particlefilena
 	WriteHeader(checkpointname, is_checkpoint, cur_time, nstep, EB_generate_max_level,output_it);
 
 	amrex::Vector<std::string> real_data_names;
-	real_data_names.push_back("radius");
-	real_data_names.push_back("xvel");
-	real_data_names.push_back("yvel");
-	real_data_names.push_back("zvel");
-	real_data_names.push_back("xvel_prime");
-	real_data_names.push_back("yvel_prime");
-	real_data_names.push_back("zvel_prime");
-	for(int i=0;i<6;i++)
-	{
-		real_data_names.push_back(amrex::Concatenate("strainrate_", i, 1));
-	}
-	for(int i=0;i<6;i++)
-	{
-		real_data_names.push_back(amrex::Concatenate("strain_", i, 1));
-	}
-	for(int i=0;i<6;i++)
-	{
-		real_data_names.push_back(amrex::Concatenate("stress_", i, 1));
-	}
-	for(int i=0;i<9;i++)
-	    {
-	    	real_data_names.push_back(amrex::Concatenate("deformationg_gradient_", i, 1));
-	    }
-	real_data_names.push_back("volume");
-	real_data_names.push_back("mass");
-	real_data_names.push_back("density");
-	real_data_names.push_back("jacobian");
-	real_data_names.push_back("pressure");
-	real_data_names.push_back("vol_init");
-	real_data_names.push_back("E");
-	real_data_names.push_back("nu");
-	real_data_names.push_back("Bulk_modulus");
-	real_data_names.push_back("Gama_pressure");
-	real_data_names.push_back("Dynamic_viscosity");
-	real_data_names.push_back("yacceleration");
+	get_particle_real_data_names(real_data_names);
 
 	amrex::Vector<std::string> int_data_names;
-	int_data_names.push_back("phase");
-	int_data_names.push_back("constitutive_model");
-	int_data_names.push_back("rigid_body_id");
+	get_particle_int_data_names(int_data_names);
 
 	Checkpoint( checkpointname, "particles", is_checkpoint, real_data_names, int_data_names);
 }
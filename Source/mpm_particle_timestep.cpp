@@ -2,39 +2,27 @@
 #include <interpolants.H>
 #include <mpm_eb.H>
 #include <mpm_kernels.H>
+#include <constitutive_models.H>
+#include <constitutive_engine.H>
 
 amrex::Real MPMParticleContainer::Calculate_time_step(amrex::Real CFL,amrex::Real dtmax,amrex::Real dtmin)
 {
     const int lev = 0;
     const Geometry& geom = Geom(lev);
-    auto& plev  = GetParticles(lev);
     const auto dx = geom.CellSizeArray();
+    const amrex::Real dxmin = amrex::min<amrex::Real>(dx[0],amrex::min<amrex::Real>(dx[1],dx[2]));
     amrex::Real dt = std::numeric_limits<amrex::Real>::max();
     
     using PType = typename MPMParticleContainer::SuperParticleType;
     dt = amrex::ReduceMin(*this, [=] 
     AMREX_GPU_HOST_DEVICE (const PType& p) -> Real 
     {
-        amrex::Real Cs;
         if(p.idata(intData::phase)==0)
         {
-			if(p.idata(intData::constitutive_model)==1)
-			{
-				Cs = sqrt(p.rdata(realData::Bulk_modulus)/p.rdata(realData::density));
-			}
-			else if(p.idata(intData::constitutive_model)==0)
-			{
-				Real lambda=p.rdata(realData::E)*p.rdata(realData::nu)/
-				((1+p.rdata(realData::nu))*(1-2.0*p.rdata(realData::nu)));
-				Real mu=p.rdata(realData::E)/(2.0*(1+p.rdata(realData::nu)));
-				Cs = sqrt((lambda+2.0*mu)/p.rdata(realData::density));
-			}
-			amrex::Real velmag=std::sqrt(p.rdata(realData::xvel)*p.rdata(realData::xvel) +
-										 p.rdata(realData::yvel)*p.rdata(realData::yvel) +
-										 p.rdata(realData::zvel)*p.rdata(realData::zvel) );
-
-			Real tscale=amrex::min<amrex::Real>(dx[0],amrex::min<amrex::Real>(dx[1],dx[2]))/(Cs+velmag);
-			return(tscale);
+            amrex::Real modulus=pwave_modulus(p.idata(intData::constitutive_model),p.rdata(realData::E),
+                                              p.rdata(realData::nu),p.rdata(realData::Bulk_modulus));
+            return(cfl_timescale(modulus,p.rdata(realData::density),p.rdata(realData::xvel),
+                                 p.rdata(realData::yvel),p.rdata(realData::zvel),dxmin));
         }
         else
         {
@@ -55,6 +43,72 @@ amrex::Real MPMParticleContainer::Calculate_time_step(amrex::Real CFL,amrex::Rea
     return(dt);
 }
 
+amrex::Real MPMParticleContainer::Next_time_step(amrex::Real CFL,amrex::Real dtmax,amrex::Real dtmin)
+{
+    //No fused estimate yet (first step or restart), fall back to a full pass
+    if(!dt_scale_valid)
+    {
+        return(Calculate_time_step(CFL,dtmax,dtmin));
+    }
+
+    amrex::Real dt = dt_scale_local;
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealMin(dt);
+#endif
+    dt_scale_valid = false;
+
+    dt	= CFL*dt;
+    dt  = (dt>dtmax)?dtmax:((dt<dtmin)?dtmin:dt);
+
+    return(dt);
+}
+
+void MPMParticleContainer::assign_multirate_levels(amrex::Real CFL,amrex::Real dt_coarse,int nlevels)
+{
+    BL_PROFILE("MPMParticleContainer::assign_multirate_levels");
+    mr_force_cache_stale=true;
+
+    const int lev = 0;
+    const Geometry& geom = Geom(lev);
+    const auto dx = geom.CellSizeArray();
+    const amrex::Real dxmin = amrex::min<amrex::Real>(dx[0],amrex::min<amrex::Real>(dx[1],dx[2]));
+    auto& plev  = GetParticles(lev);
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const size_t np = aos.numParticles();
+        ParticleType* pstruct = aos().dataPtr();
+
+        //smallest power-of-two subdivision of dt_coarse that meets the particle's own CFL limit
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            ParticleType& p = pstruct[i];
+            int level=0;
+            if(p.idata(intData::phase)==0)
+            {
+                amrex::Real modulus=pwave_modulus(p.idata(intData::constitutive_model),p.rdata(realData::E),
+                                                  p.rdata(realData::nu),p.rdata(realData::Bulk_modulus));
+                amrex::Real dt_p=CFL*cfl_timescale(modulus,p.rdata(realData::density),p.rdata(realData::xvel),
+                                                   p.rdata(realData::yvel),p.rdata(realData::zvel),dxmin);
+                amrex::Real dt_level=dt_coarse;
+                while(level<nlevels-1 && dt_level>dt_p)
+                {
+                    dt_level*=half;
+                    level++;
+                }
+            }
+            p.idata(intData::dt_level)=level;
+        });
+    }
+}
+
 void MPMParticleContainer::updateVolume(const amrex::Real& dt)
 {
     BL_PROFILE("MPMParticleContainer::updateVolume");
@@ -70,6 +124,13 @@ void MPMParticleContainer::updateVolume(const amrex::Real& dt)
         Geom(lev).isPeriodic(YDIR),
         Geom(lev).isPeriodic(ZDIR)};
 
+    //This is the last kernel of a step that changes velocity or density, so
+    //the CFL estimate for the next step is accumulated here as well
+    const amrex::Real dxmin = amrex::min<amrex::Real>(dx[0],amrex::min<amrex::Real>(dx[1],dx[2]));
+    ReduceOps<ReduceOpMin> reduce_op;
+    ReduceData<Real> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
         int gid = mfi.index();
@@ -82,20 +143,27 @@ void MPMParticleContainer::updateVolume(const amrex::Real& dt)
         ParticleType* pstruct = aos().dataPtr();
 
         // now we move the particles
-        amrex::ParallelFor(np,[=]
-        AMREX_GPU_DEVICE (int i) noexcept
+        reduce_op.eval(np, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i) -> ReduceTuple
         {
             ParticleType& p = pstruct[i];
+            amrex::Real tscale=std::numeric_limits<amrex::Real>::max();
             if(p.idata(intData::phase)==0)
             {
-				p.rdata(realData::jacobian) = p.rdata(realData::deformation_gradient+0)*(p.rdata(realData::deformation_gradient+4)*p.rdata(realData::deformation_gradient+8)-p.rdata(realData::deformation_gradient+7)*p.rdata(realData::deformation_gradient+5))-
-											  p.rdata(realData::deformation_gradient+1)*(p.rdata(realData::deformation_gradient+3)*p.rdata(realData::deformation_gradient+8)-p.rdata(realData::deformation_gradient+6)*p.rdata(realData::deformation_gradient+5))+
-											  p.rdata(realData::deformation_gradient+2)*(p.rdata(realData::deformation_gradient+3)*p.rdata(realData::deformation_gradient+7)-p.rdata(realData::deformation_gradient+6)*p.rdata(realData::deformation_gradient+4));
-				p.rdata(realData::volume)	= p.rdata(realData::vol_init)*p.rdata(realData::jacobian);
-				p.rdata(realData::density)	= p.rdata(realData::mass)/p.rdata(realData::volume);
+				update_point_volume(p);
+
+				amrex::Real modulus=pwave_modulus(p.idata(intData::constitutive_model),p.rdata(realData::E),
+				                                  p.rdata(realData::nu),p.rdata(realData::Bulk_modulus));
+				tscale=cfl_timescale(modulus,p.rdata(realData::density),p.rdata(realData::xvel),
+				                     p.rdata(realData::yvel),p.rdata(realData::zvel),dxmin);
             }
+            return {tscale};
         });
     }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    dt_scale_local = amrex::get<0>(hv);
+    dt_scale_valid = true;
 }
 
 void MPMParticleContainer::moveParticles(const amrex::Real& dt,
@@ -112,45 +180,15 @@ void MPMParticleContainer::moveParticles(const amrex::Real& dt,
 
     const int lev = 0;
     const Geometry& geom = Geom(lev);
-    const auto plo = Geom(lev).ProbLoArray();
-    const auto phi = Geom(lev).ProbHiArray();
-    const auto dx = Geom(lev).CellSizeArray();
     auto& plev  = GetParticles(lev);
 
-    bool using_levsets=mpm_ebtools::using_levelset_geometry;
-    int lsref=mpm_ebtools::ls_refinement;
+    ParticleWallBC wallbc=make_particle_wall_bc(geom,bclo,bchi,lsetbc,wall_mu_lo,wall_mu_hi,
+                                                wall_vel_lo,wall_vel_hi,lset_wall_mu);
+    set_particle_sinks(wallbc,sink_regions);
 
-    //Some GPU stuff again (Sreejith)
-    GpuArray<int,AMREX_SPACEDIM> bc_lo_arr;
-    GpuArray<int,AMREX_SPACEDIM> bc_hi_arr;
-
-    for(int d=0;d<AMREX_SPACEDIM;d++)
-    {
-    	bc_lo_arr[d]=bclo[d];
-    	bc_hi_arr[d]=bchi[d];
-    }
-
-    GpuArray<Real,AMREX_SPACEDIM*AMREX_SPACEDIM> wall_vel_lo_arr;
-    GpuArray<Real,AMREX_SPACEDIM*AMREX_SPACEDIM> wall_vel_hi_arr;
-
-    for(int d=0;d<AMREX_SPACEDIM*AMREX_SPACEDIM;d++)
-    {
-    	wall_vel_lo_arr[d]=wall_vel_lo[d];
-    	wall_vel_hi_arr[d]=wall_vel_hi[d];
-    }
-
-    GpuArray<Real,AMREX_SPACEDIM*AMREX_SPACEDIM> wall_mu_lo_arr;
-    GpuArray<Real,AMREX_SPACEDIM*AMREX_SPACEDIM> wall_mu_hi_arr;
-
-    for(int d=0;d<AMREX_SPACEDIM*AMREX_SPACEDIM;d++)
-    {
-    	wall_mu_lo_arr[d]=wall_mu_lo[d];
-    	wall_mu_hi_arr[d]=wall_mu_hi[d];
-    }
-
-    int periodic[AMREX_SPACEDIM]={Geom(lev).isPeriodic(XDIR),
-        Geom(lev).isPeriodic(YDIR),
-        Geom(lev).isPeriodic(ZDIR)};
+    ReduceOps<ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum,ReduceOpSum> reduce_op;
+    ReduceData<Real,Real,Real,Real,Long> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
 
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
     {
@@ -163,15 +201,18 @@ void MPMParticleContainer::moveParticles(const amrex::Real& dt,
         const size_t np = aos.numParticles();
         ParticleType* pstruct = aos().dataPtr();
 
+        //tiles away from the level-set narrow band skip the wall query
+        ParticleWallBC tilebc=wallbc;
+        tilebc.using_levsets=(wallbc.using_levsets && mpm_ebtools::near_eb(mfi));
         amrex::Array4<amrex::Real> lsetarr;
-        if(using_levsets)
+        if(tilebc.using_levsets)
         {
             lsetarr=mpm_ebtools::lsphi->array(mfi);
         }
 
         // now we move the particles
-        amrex::ParallelFor(np,[=]
-        AMREX_GPU_DEVICE (int i) noexcept
+        reduce_op.eval(np, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i) -> ReduceTuple
         {
             ParticleType& p = pstruct[i];
 
@@ -182,171 +223,43 @@ void MPMParticleContainer::moveParticles(const amrex::Real& dt,
             	p.pos(ZDIR) += p.rdata(realData::zvel_prime) * dt;
             }
 
-            if(p.idata(intData::phase)==0)
+            if(p.idata(intData::phase)==0 && p.id()>=0)
             {
+                amrex::Real pos[AMREX_SPACEDIM]={p.pos(XDIR),p.pos(YDIR),p.pos(ZDIR)};
+                amrex::Real vel[AMREX_SPACEDIM]={p.rdata(realData::xvel),p.rdata(realData::yvel),p.rdata(realData::zvel)};
+                amrex::Real vel_prime[AMREX_SPACEDIM]={p.rdata(realData::xvel_prime),
+                                                       p.rdata(realData::yvel_prime),
+                                                       p.rdata(realData::zvel_prime)};
 
-            p.pos(XDIR) += p.rdata(realData::xvel_prime) * dt;
-            p.pos(YDIR) += p.rdata(realData::yvel_prime) * dt;
-            p.pos(ZDIR) += p.rdata(realData::zvel_prime) * dt;
+                bool removed=move_material_point(pos,vel,vel_prime,dt,tilebc,lsetarr);
 
-            //for imposing boundary conditions           
-            Real relvel_in[AMREX_SPACEDIM]  = {p.rdata(realData::xvel),p.rdata(realData::yvel),p.rdata(realData::zvel)};
-            Real relvel_out[AMREX_SPACEDIM] = {p.rdata(realData::xvel),p.rdata(realData::yvel),p.rdata(realData::zvel)};
-
-            if(using_levsets)
-            {
-                amrex::Real eps=0.00001;
-                amrex::Real xp[AMREX_SPACEDIM]={p.pos(XDIR),p.pos(YDIR),p.pos(ZDIR)}; 
-                amrex::Real dist=get_levelset_value(lsetarr,plo,dx,xp,lsref); 
-
-               if(dist<TINYVAL)
-               {
-                    amrex::Real normaldir[AMREX_SPACEDIM]={1.0,0.0,0.0};
-                    get_levelset_grad(lsetarr,plo,dx,xp,lsref,normaldir);
-                    amrex::Real gradmag=std::sqrt(normaldir[XDIR]*normaldir[XDIR]
-                                                 +normaldir[YDIR]*normaldir[YDIR]
-                                                 +normaldir[ZDIR]*normaldir[ZDIR]);
-
-                    normaldir[XDIR]=normaldir[XDIR]/(gradmag+TINYVAL);
-                    normaldir[YDIR]=normaldir[YDIR]/(gradmag+TINYVAL);
-                    normaldir[ZDIR]=normaldir[ZDIR]/(gradmag+TINYVAL);
-                
-                    int modify_pos=applybc(relvel_in,relvel_out,lset_wall_mu,
-                        normaldir,lsetbc);
-                    
-                    if(modify_pos)
-                    {
-                        p.pos(XDIR) += 2.0*amrex::Math::abs(dist)*normaldir[XDIR];
-                        p.pos(YDIR) += 2.0*amrex::Math::abs(dist)*normaldir[YDIR];
-                        p.pos(ZDIR) += 2.0*amrex::Math::abs(dist)*normaldir[ZDIR];
-                    }
-
-                    p.rdata(realData::xvel)=relvel_out[XDIR];
-                    p.rdata(realData::yvel)=relvel_out[YDIR];
-                    p.rdata(realData::zvel)=relvel_out[ZDIR];
-               }
-            }
-            
-            relvel_in[XDIR]   = p.rdata(realData::xvel);
-            relvel_in[YDIR]   = p.rdata(realData::yvel);
-            relvel_in[ZDIR]   = p.rdata(realData::zvel);
-
-            relvel_out[XDIR]  = p.rdata(realData::xvel);
-            relvel_out[YDIR]  = p.rdata(realData::yvel);
-            relvel_out[ZDIR]  = p.rdata(realData::zvel);
-
-            amrex::Real wallvel[AMREX_SPACEDIM]={0.0,0.0,0.0};
-
-            if (p.pos(XDIR) < plo[XDIR])
-            {
-                int dir=XDIR;
                 for(int d=0;d<AMREX_SPACEDIM;d++)
                 {
-                    wallvel[d]=wall_vel_lo_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
-                }
-                
-                Real normaldir[AMREX_SPACEDIM]={1.0,0.0,0.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo[XDIR],normaldir,bclo[XDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo_arr[XDIR],normaldir,bc_lo_arr[XDIR]);
-                if(modify_pos)
-                {
-                    p.pos(XDIR) = two*plo[XDIR] - p.pos(XDIR);
-                }
-            }
-            else if (p.pos(XDIR) > phi[XDIR])
-            {
-                int dir=XDIR;
-                for(int d=0;d<AMREX_SPACEDIM;d++)
-                {
-                    wallvel[d]=wall_vel_hi_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
+                    p.pos(d)=pos[d];
                 }
+                p.rdata(realData::xvel)=vel[XDIR];
+                p.rdata(realData::yvel)=vel[YDIR];
+                p.rdata(realData::zvel)=vel[ZDIR];
 
-                Real normaldir[AMREX_SPACEDIM]={-1.0,0.0,0.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi[XDIR],normaldir,bchi[XDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi_arr[XDIR],normaldir,bc_hi_arr[XDIR]);
-                if(modify_pos)
-                {
-                    p.pos(XDIR) = two*phi[XDIR] - p.pos(XDIR);
-                }
-            }
-            if (p.pos(YDIR) < plo[YDIR])
-            {
-                int dir=YDIR;
-                for(int d=0;d<AMREX_SPACEDIM;d++)
-                {
-                    wallvel[d]=wall_vel_lo_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
-                }
-                
-                Real normaldir[AMREX_SPACEDIM]={0.0,1.0,0.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo[YDIR],normaldir,bclo[YDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo_arr[YDIR],normaldir,bc_lo_arr[YDIR]);
-                if(modify_pos)
+                if(removed)
                 {
-                    p.pos(YDIR) = two*plo[YDIR] - p.pos(YDIR);
+                    const amrex::Real mp=p.rdata(realData::mass);
+                    p.id()=-1;
+                    p.rdata(realData::mass)=zero;
+                    p.rdata(realData::volume)=zero;
+                    return {mp,mp*vel[XDIR],mp*vel[YDIR],mp*vel[ZDIR],1};
                 }
             }
-            else if (p.pos(YDIR) > phi[YDIR])
-            {
-                int dir=YDIR;
-                for(int d=0;d<AMREX_SPACEDIM;d++)
-                {
-                    wallvel[d]=wall_vel_hi_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
-                }
-            
-                Real normaldir[AMREX_SPACEDIM]={0.0,-1.0,0.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi[YDIR],normaldir,bchi[YDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi[YDIR],normaldir,bc_hi_arr[YDIR]);
-                if(modify_pos)
-                {
-                    p.pos(YDIR) = two*phi[YDIR] - p.pos(YDIR);
-                }
-            }
-            if (p.pos(ZDIR) < plo[ZDIR])
-            {
-                int dir=ZDIR;
-                for(int d=0;d<AMREX_SPACEDIM;d++)
-                {
-                    wallvel[d]=wall_vel_lo_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
-                }
-            
-                Real normaldir[AMREX_SPACEDIM]={0.0,0.0,1.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo[ZDIR],normaldir,bclo[ZDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_lo_arr[ZDIR],normaldir,bc_lo_arr[ZDIR]);
-                if(modify_pos)
-                {
-                    p.pos(ZDIR) = two*plo[ZDIR] - p.pos(ZDIR);
-                }
-            }
-            else if (p.pos(ZDIR) > phi[ZDIR])
-            {
-                int dir=ZDIR;
-                for(int d=0;d<AMREX_SPACEDIM;d++)
-                {
-                    wallvel[d]=wall_vel_hi_arr[dir*AMREX_SPACEDIM+d];
-                    relvel_in[d] -= wallvel[d];
-                }
-            
-                Real normaldir[AMREX_SPACEDIM]={0.0,0.0,-1.0};
-                //int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi[ZDIR],normaldir,bchi[ZDIR]);
-                int modify_pos=applybc(relvel_in,relvel_out,wall_mu_hi_arr[ZDIR],normaldir,bc_hi_arr[ZDIR]);
-                if(modify_pos)
-                {
-                    p.pos(ZDIR) = two*phi[ZDIR] - p.pos(ZDIR);
-                }
-            }
-            else //nothing to do
-            {}
-            p.rdata(realData::xvel)=relvel_out[XDIR]+wallvel[XDIR];
-            p.rdata(realData::yvel)=relvel_out[YDIR]+wallvel[YDIR];
-            p.rdata(realData::zvel)=relvel_out[ZDIR]+wallvel[ZDIR];
-            }
+            return {zero,zero,zero,zero,0};
         });
     }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    removed_mass_local += amrex::get<0>(hv);
+    removed_momentum_local[XDIR] += amrex::get<1>(hv);
+    removed_momentum_local[YDIR] += amrex::get<2>(hv);
+    removed_momentum_local[ZDIR] += amrex::get<3>(hv);
+    removed_count_local += amrex::get<4>(hv);
 }
 
 amrex::Real MPMParticleContainer::GetPosSpring()
@@ -364,7 +277,7 @@ amrex::Real MPMParticleContainer::GetPosSpring()
 			AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
 	        {
 	        	Real yscale;
-	        	yscale = p.pos(YDIR);
+	        	yscale = (p.id()>=0)?p.pos(YDIR):std::numeric_limits<amrex::Real>::lowest();
 	        	return(yscale);
 	         });
 	return(ymin);
@@ -386,7 +299,7 @@ amrex::Real MPMParticleContainer::GetPosPiston()
 			AMREX_GPU_HOST_DEVICE (const PType& p) -> Real
 	        {
 	        	Real yscale;
-	        	if(p.idata(intData::phase)==1 and p.idata(intData::rigid_body_id)==0)
+	        	if(p.idata(intData::phase)==1 and p.idata(intData::rigid_body_id)==0 and p.id()>=0)
 	            {
 	        		yscale = p.pos(YDIR);
 	            }
@@ -401,16 +314,16 @@ amrex::Real MPMParticleContainer::GetPosPiston()
 }
 
 
-void MPMParticleContainer::UpdateRigidParticleVelocities(int rigid_body_id,Array <amrex::Real,AMREX_SPACEDIM> velocity)
+//Gives every rigid particle the velocity that carries it along its body's
+//rigid motion over the step, RIGID_MOTION_COMPS entries per body
+void MPMParticleContainer::UpdateRigidParticleVelocities(int nbodies,const Gpu::DeviceVector<amrex::Real> &body_motion,
+                                                         const amrex::Real& dt)
 {
-    BL_PROFILE("MPMParticleContainer::GetVelPiston");
+    BL_PROFILE("MPMParticleContainer::UpdateRigidParticleVelocities");
 
     const int lev = 0;
-    const Geometry& geom = Geom(lev);
-    const auto plo = Geom(lev).ProbLoArray();
-    const auto phi = Geom(lev).ProbHiArray();
-    const auto dx = Geom(lev).CellSizeArray();
     auto& plev  = GetParticles(lev);
+    const amrex::Real* motionptr=body_motion.dataPtr();
 
     for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
         {
@@ -423,20 +336,55 @@ void MPMParticleContainer::UpdateRigidParticleVelocities(int rigid_body_id,Array
             const size_t np = aos.numParticles();
             ParticleType* pstruct = aos().dataPtr();
 
-            // now we move the particles
             amrex::ParallelFor(np,[=]
             AMREX_GPU_DEVICE (int i) noexcept
             {
                 ParticleType& p = pstruct[i];
-                if(p.idata(intData::phase)==1 and p.idata(intData::rigid_body_id)==rigid_body_id)
+                int b=p.idata(intData::rigid_body_id);
+                if(p.idata(intData::phase)==1 and b>=0 and b<nbodies)
                 {
-                	p.rdata(realData::xvel_prime) =velocity[0];
-                	p.rdata(realData::yvel_prime) =velocity[1];
-                	p.rdata(realData::zvel_prime) =velocity[2];
+                	amrex::Real xp[AMREX_SPACEDIM]={p.pos(XDIR),p.pos(YDIR),p.pos(ZDIR)};
+                	amrex::Real vel[AMREX_SPACEDIM];
+                	rigid_point_step_velocity(motionptr+RIGID_MOTION_COMPS*b,xp,dt,vel);
+                	p.rdata(realData::xvel_prime) =vel[XDIR];
+                	p.rdata(realData::yvel_prime) =vel[YDIR];
+                	p.rdata(realData::zvel_prime) =vel[ZDIR];
                 }
             });
         }
 
 }
 
+void MPMParticleContainer::ResetMaterialParticleVelocities()
+{
+    BL_PROFILE("MPMParticleContainer::ResetMaterialParticleVelocities");
+
+    const int lev = 0;
+    auto& plev  = GetParticles(lev);
+
+    for(MFIter mfi = MakeMFIter(lev); mfi.isValid(); ++mfi)
+    {
+        int gid = mfi.index();
+        int tid = mfi.LocalTileIndex();
+        auto index = std::make_pair(gid, tid);
+
+        auto& ptile = plev[index];
+        auto& aos   = ptile.GetArrayOfStructs();
+        const size_t np = aos.numParticles();
+        ParticleType* pstruct = aos().dataPtr();
+
+        amrex::ParallelFor(np,[=]
+        AMREX_GPU_DEVICE (int i) noexcept
+        {
+            ParticleType& p = pstruct[i];
+            if(p.idata(intData::phase)==0)
+            {
+                p.rdata(realData::xvel) = zero;
+                p.rdata(realData::yvel) = zero;
+                p.rdata(realData::zvel) = zero;
+            }
+        });
+    }
+}
+
 
@@ -0,0 +1,351 @@
+#include <mpm_probes.H>
+#include <nodal_data_ops.H>
+#include <interpolants.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+
+using namespace amrex;
+
+void MPMProbes::read_probes(const Geometry &geom, const NodalData &nodal, bool restarting)
+{
+    ParmParse pp("probes");
+
+    Vector<std::string> setnames;
+    pp.queryarr("sets",setnames);
+    if(setnames.empty())
+    {
+        return;
+    }
+
+    //all sets share one buffered writer, one stream per set
+    writer.read_specs("probes",restarting,"./probe_files/","csv");
+
+    Vector<std::string> particle_names;
+    get_particle_real_data_names(particle_names);
+
+    const auto prob_lo = geom.ProbLoArray();
+    const auto prob_hi = geom.ProbHiArray();
+
+    for(int s=0;s<setnames.size();s++)
+    {
+        ProbeSet ps;
+        ps.name=setnames[s];
+
+        ParmParse pps("probes."+ps.name);
+        pps.get("type",ps.type);
+        pps.query("interval",ps.interval);
+        if(ps.interval<1)
+        {
+            amrex::Abort("\nprobes."+ps.name+".interval should be at least 1");
+        }
+
+        Vector<std::string> requested;
+        pps.queryarr("fields",requested);
+
+        if(ps.type=="particles")
+        {
+            pps.getarr("ids",ps.particle_ids);
+            std::sort(ps.particle_ids.begin(),ps.particle_ids.end());
+
+            if(requested.empty())
+            {
+                requested={"pos_x","pos_y","pos_z","xvel","yvel","zvel"};
+            }
+            for(int f=0;f<requested.size();f++)
+            {
+                int comp=-1000;
+                if(requested[f]=="pos_x") comp=PARTICLE_DERIVED_POSX;
+                else if(requested[f]=="pos_y") comp=PARTICLE_DERIVED_POSY;
+                else if(requested[f]=="pos_z") comp=PARTICLE_DERIVED_POSZ;
+                else
+                {
+                    for(int n=0;n<particle_names.size();n++)
+                    {
+                        if(particle_names[n]==requested[f])
+                        {
+                            comp=n;
+                        }
+                    }
+                }
+                if(comp==-1000)
+                {
+                    amrex::Abort("\nUnknown particle field "+requested[f]+" in probes."+ps.name+".fields");
+                }
+                ps.fieldnames.push_back(requested[f]);
+                ps.fieldcomps.push_back(comp);
+            }
+        }
+        else
+        {
+            if(ps.type=="point")
+            {
+                pps.getarr("locations",ps.locations);
+                if(ps.locations.size()%3!=0)
+                {
+                    amrex::Abort("\nprobes."+ps.name+".locations should be a list of x y z triplets");
+                }
+            }
+            else if(ps.type=="line")
+            {
+                Vector<Real> start,end;
+                int npoints=2;
+                pps.getarr("start",start);
+                pps.getarr("end",end);
+                pps.get("npoints",npoints);
+                if(npoints<2)
+                {
+                    amrex::Abort("\nprobes."+ps.name+".npoints should be at least 2");
+                }
+                for(int i=0;i<npoints;i++)
+                {
+                    Real frac=Real(i)/Real(npoints-1);
+                    for(int d=0;d<3;d++)
+                    {
+                        ps.locations.push_back(start[d]+frac*(end[d]-start[d]));
+                    }
+                }
+            }
+            else if(ps.type=="plane")
+            {
+                Vector<Real> origin,u,v;
+                int nu=2;
+                int nv=2;
+                pps.getarr("origin",origin);
+                pps.getarr("u",u);
+                pps.getarr("v",v);
+                pps.get("nu",nu);
+                pps.get("nv",nv);
+                if(nu<2 || nv<2)
+                {
+                    amrex::Abort("\nprobes."+ps.name+".nu and nv should be at least 2");
+                }
+                for(int j=0;j<nv;j++)
+                {
+                    for(int i=0;i<nu;i++)
+                    {
+                        Real fu=Real(i)/Real(nu-1);
+                        Real fv=Real(j)/Real(nv-1);
+                        for(int d=0;d<3;d++)
+                        {
+                            ps.locations.push_back(origin[d]+fu*u[d]+fv*v[d]);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                amrex::Abort("\nUnknown probe type "+ps.type+" for probes."+ps.name);
+            }
+
+            for(int i=0;i<ps.locations.size()/3;i++)
+            {
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    if(ps.locations[3*i+d]<prob_lo[d] || ps.locations[3*i+d]>prob_hi[d])
+                    {
+                        amrex::Abort("\nProbe point outside the domain in probes."+ps.name);
+                    }
+                }
+            }
+
+            if(requested.empty())
+            {
+                requested={"mass","vel_x","vel_y","vel_z"};
+            }
+            select_nodal_output_fields(requested,nodal,ps.fieldnames,ps.fieldcomps);
+
+            //feature fields carry no ghost nodes for the cubic stencil
+            for(int f=0;f<ps.fieldcomps.size();f++)
+            {
+                if(ps.fieldcomps[f]>=NUM_STATES)
+                {
+                    amrex::Abort("\nGrid probes sample core nodal fields only, check probes."+ps.name+".fields");
+                }
+            }
+        }
+
+        set_columns(ps);
+        probesets.push_back(ps);
+    }
+
+    std::string output_folder="./probe_files/";
+    pp.query("output_folder",output_folder);
+    if(output_folder.back()!='/')
+    {
+        output_folder+="/";
+    }
+
+    if(ParallelDescriptor::IOProcessor())
+    {
+        for(int s=0;s<probesets.size();s++)
+        {
+            ProbeSet &ps=probesets[s];
+
+            //point coordinates are written once so the stream only carries values
+            if(ps.type!="particles")
+            {
+                std::ofstream ofs(output_folder+ps.name+".points",std::ofstream::trunc);
+                ofs.precision(10);
+                for(int i=0;i<ps.locations.size()/3;i++)
+                {
+                    ofs<<i<<"\t"<<ps.locations[3*i]<<"\t"<<ps.locations[3*i+1]<<"\t"<<ps.locations[3*i+2]<<"\n";
+                }
+            }
+        }
+    }
+}
+
+void MPMProbes::set_columns(ProbeSet &ps)
+{
+    int nloc=(ps.type=="particles")?ps.particle_ids.size():ps.locations.size()/3;
+
+    ps.columns.clear();
+    ps.columns.push_back("time");
+    for(int i=0;i<nloc;i++)
+    {
+        std::string tag=(ps.type=="particles")?("_id"+std::to_string(ps.particle_ids[i])):("_p"+std::to_string(i));
+        for(int f=0;f<ps.fieldnames.size();f++)
+        {
+            ps.columns.push_back(ps.fieldnames[f]+tag);
+        }
+    }
+}
+
+void MPMProbes::sample_grid(ProbeSet &ps, MultiFab &nodaldata, const Geometry &geom,
+                            GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
+                            Vector<Real> &values)
+{
+    const auto dxi = geom.InvCellSizeArray();
+    const auto dx = geom.CellSizeArray();
+    const auto plo = geom.ProbLoArray();
+    const auto domain = geom.Domain();
+
+    const int* loarr = domain.loVect ();
+    const int* hiarr = domain.hiVect ();
+    int lo[]={loarr[0],loarr[1],loarr[2]};
+    int hi[]={hiarr[0],hiarr[1],hiarr[2]};
+
+    int npts=ps.locations.size()/3;
+    int nfields=ps.fieldcomps.size();
+
+    Gpu::DeviceVector<Real> locs_d(ps.locations.size());
+    Gpu::DeviceVector<int> comps_d(nfields);
+    Gpu::DeviceVector<Real> values_d(npts*nfields,zero);
+    Gpu::copy(Gpu::hostToDevice,ps.locations.begin(),ps.locations.end(),locs_d.begin());
+    Gpu::copy(Gpu::hostToDevice,ps.fieldcomps.begin(),ps.fieldcomps.end(),comps_d.begin());
+
+    const Real* locptr=locs_d.dataPtr();
+    const int* compptr=comps_d.dataPtr();
+    Real* valptr=values_d.dataPtr();
+
+    //points are evaluated from owned cells only
+    fill_nodal_ghosts(nodaldata,geom,0,nodaldata.nComp(),
+                      nodal_gather_ghosts(order_scheme_directional,0));
+
+    for(MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    {
+        //cells owned by this box, so each point is evaluated on one rank only
+        const Box cellbox=amrex::enclosedCells(mfi.validbox());
+        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+
+        amrex::ParallelFor(npts,[=]
+        AMREX_GPU_DEVICE (int ip) noexcept
+        {
+            int lmin,lmax,nmin,nmax,mmin,mmax;
+            amrex::Real xp[AMREX_SPACEDIM];
+            IntVect iv;
+
+            for(int d=0;d<AMREX_SPACEDIM;d++)
+            {
+                xp[d]=locptr[3*ip+d];
+                iv[d]=static_cast<int>(amrex::Math::floor((xp[d]-plo[d])*dxi[d]));
+                iv[d]=amrex::max(lo[d],amrex::min(hi[d],iv[d]));
+            }
+
+            if(!cellbox.contains(iv))
+            {
+                return;
+            }
+
+            lmin=(order_scheme_directional[0]==1)?0:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?0:((iv[XDIR]==hi[XDIR])?-1:-1):-1000);
+            lmax=(order_scheme_directional[0]==1)?2:((order_scheme_directional[0]==3)?(iv[XDIR]==lo[XDIR])?lmin+3:((iv[XDIR]==hi[XDIR])?lmin+3:lmin+4):-1000);
+
+            mmin=(order_scheme_directional[1]==1)?0:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?0:((iv[YDIR]==hi[YDIR])?-1:-1):-1000);
+            mmax=(order_scheme_directional[1]==1)?2:((order_scheme_directional[1]==3)?(iv[YDIR]==lo[YDIR])?mmin+3:((iv[YDIR]==hi[YDIR])?mmin+3:mmin+4):-1000);
+
+            nmin=(order_scheme_directional[2]==1)?0:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?0:((iv[ZDIR]==hi[ZDIR])?-1:-1):-1000);
+            nmax=(order_scheme_directional[2]==1)?2:((order_scheme_directional[2]==3)?(iv[ZDIR]==lo[ZDIR])?nmin+3:((iv[ZDIR]==hi[ZDIR])?nmin+3:nmin+4):-1000);
+
+            auto interp=[&](int comp)
+            {
+                return((order_scheme_directional[0]==1)?
+                       bilin_interp(xp,iv[XDIR],iv[YDIR],iv[ZDIR],plo,dx,nodal_data_arr,comp):
+                       cubic_interp(xp,iv[XDIR],iv[YDIR],iv[ZDIR],lmin,mmin,nmin,lmax,mmax,nmax,plo,dx,nodal_data_arr,comp,lo,hi));
+            };
+
+            for(int f=0;f<nfields;f++)
+            {
+                int comp=compptr[f];
+                amrex::Real val=zero;
+                if(comp>=0)
+                {
+                    val=interp(comp);
+                }
+                else if(comp==NODAL_DERIVED_VELMAG)
+                {
+                    amrex::Real vx=interp(VELX_INDEX);
+                    amrex::Real vy=interp(VELY_INDEX);
+                    amrex::Real vz=interp(VELZ_INDEX);
+                    val=std::sqrt(vx*vx+vy*vy+vz*vz);
+                }
+                else if(comp==NODAL_DERIVED_FRCMAG)
+                {
+                    amrex::Real fx=interp(FRCX_INDEX);
+                    amrex::Real fy=interp(FRCY_INDEX);
+                    amrex::Real fz=interp(FRCZ_INDEX);
+                    val=std::sqrt(fx*fx+fy*fy+fz*fz);
+                }
+                valptr[ip*nfields+f]=val;
+            }
+        });
+    }
+
+    values.resize(npts*nfields);
+    Gpu::copy(Gpu::deviceToHost,values_d.begin(),values_d.end(),values.begin());
+
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealSum(values.dataPtr(),values.size());
+#endif
+}
+
+void MPMProbes::sample(MPMParticleContainer &mpm_pc, MultiFab &nodaldata,
+                       const Geometry &geom,
+                       GpuArray<int,AMREX_SPACEDIM> order_scheme_directional,
+                       int nstep, Real time)
+{
+    BL_PROFILE("MPMProbes::sample");
+    for(int s=0;s<probesets.size();s++)
+    {
+        ProbeSet &ps=probesets[s];
+        if(nstep%ps.interval!=0)
+        {
+            continue;
+        }
+
+        Vector<Real> values;
+        values.push_back(time);
+
+        Vector<Real> samples;
+        if(ps.type=="particles")
+        {
+            mpm_pc.sample_particle_data(ps.particle_ids,ps.fieldcomps,samples);
+        }
+        else
+        {
+            sample_grid(ps,nodaldata,geom,order_scheme_directional,samples);
+        }
+        values.insert(values.end(),samples.begin(),samples.end());
+
+        writer.record(ps.name,ps.columns,values);
+    }
+}
@@ -0,0 +1,104 @@
+#include <mpm_vtk.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <fstream>
+#include <sstream>
+
+using namespace amrex;
+
+namespace mpm_vtk
+{
+    std::string AppendedData::add_array(const std::string &name, const std::string &type,
+                                        int ncomp, const void *data, std::uint64_t nbytes)
+    {
+        std::ostringstream tag;
+        tag<<"<DataArray type=\""<<type<<"\" Name=\""<<name<<"\" NumberOfComponents=\""<<ncomp
+           <<"\" format=\"appended\" offset=\""<<blob.size()<<"\"/>\n";
+
+        blob.append(reinterpret_cast<const char*>(&nbytes),sizeof(std::uint64_t));
+        if(nbytes>0)
+        {
+            blob.append(reinterpret_cast<const char*>(data),nbytes);
+        }
+        return(tag.str());
+    }
+
+    void AppendedData::write(std::ostream &os) const
+    {
+        os<<"<AppendedData encoding=\"raw\">\n_";
+        os.write(blob.data(),blob.size());
+        os<<"\n</AppendedData>\n";
+    }
+
+    std::string file_header(const std::string &type)
+    {
+        const std::uint16_t one_byte=1;
+        bool little_endian=(*reinterpret_cast<const char*>(&one_byte)==1);
+
+        std::string header="<?xml version=\"1.0\"?>\n";
+        header+="<VTKFile type=\""+type+"\" version=\"1.0\" byte_order=\"";
+        header+=(little_endian)?"LittleEndian":"BigEndian";
+        header+="\" header_type=\"UInt64\">\n";
+        return(header);
+    }
+
+    std::string file_footer(const std::string &type)
+    {
+        return("</"+type+">\n</VTKFile>\n");
+    }
+
+    void PVDCollection::init(const std::string &fname, bool restarting, Real time)
+    {
+        filename=fname;
+        times.clear();
+        files.clear();
+
+        //keep entries of the run we restart from, up to the restart time
+        if(restarting && ParallelDescriptor::IOProcessor())
+        {
+            std::ifstream ifs(filename);
+            std::string line;
+            while(std::getline(ifs,line))
+            {
+                std::size_t tpos=line.find("timestep=\"");
+                std::size_t fpos=line.find("file=\"");
+                if(line.find("<DataSet")==std::string::npos || tpos==std::string::npos || fpos==std::string::npos)
+                {
+                    continue;
+                }
+                tpos+=10;
+                fpos+=6;
+                Real t=std::stod(line.substr(tpos,line.find('"',tpos)-tpos));
+                if(t<=time)
+                {
+                    times.push_back(t);
+                    files.push_back(line.substr(fpos,line.find('"',fpos)-fpos));
+                }
+            }
+        }
+    }
+
+    void PVDCollection::add(Real time, const std::string &file)
+    {
+        times.push_back(time);
+        files.push_back(file);
+        write();
+    }
+
+    void PVDCollection::write() const
+    {
+        if(!ParallelDescriptor::IOProcessor())
+        {
+            return;
+        }
+
+        std::ofstream ofs(filename,std::ofstream::trunc);
+        ofs.precision(17);
+        ofs<<"<?xml version=\"1.0\"?>\n";
+        ofs<<"<VTKFile type=\"Collection\" version=\"1.0\">\n<Collection>\n";
+        for(int i=0;i<times.size();i++)
+        {
+            ofs<<"<DataSet timestep=\""<<times[i]<<"\" group=\"\" part=\"0\" file=\""<<files[i]<<"\"/>\n";
+        }
+        ofs<<"</Collection>\n</VTKFile>\n";
+    }
+}
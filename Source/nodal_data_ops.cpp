@@ -1,15 +1,351 @@
 #include <nodal_data_ops.H>
 #include <mpm_eb.H>
 #include <mpm_kernels.H>
+#include <mpm_vtk.H>
+#include <AMReX_Utility.H>
 
 using namespace amrex;
 
-void write_grid_file(std::string fname, MultiFab &nodaldata, Vector<std::string> fieldnames, 
-                           Geometry geom, BoxArray ba, DistributionMapping dm,Real time)
+void NodalData::define(const BoxArray& nodeba,const DistributionMapping& dm,
+                       const IntVect& ngrow,int with_rigid,int with_stress)
 {
-  MultiFab plotmf(ba,dm,nodaldata.nComp(),0);
-  average_node_to_cellcenter(plotmf, 0, nodaldata, 0, nodaldata.nComp());
-  WriteSingleLevelPlotfile(fname, plotmf, fieldnames, geom, time, 0);
+    core.define(nodeba,dm,NUM_STATES,ngrow);
+    core.setVal(zero,ngrow);
+
+    //feature fields are only read on valid nodes
+    if(with_rigid)
+    {
+        rigid.define(nodeba,dm,NUM_RIGID_STATES,0);
+        rigid.setVal(zero);
+    }
+    if(with_stress)
+    {
+        stress.define(nodeba,dm,NUM_STRESS_STATES,0);
+        stress.setVal(zero);
+    }
+}
+
+const MultiFab* NodalData::field(int gcomp,int& comp) const
+{
+    comp=-1;
+    if(gcomp<0)
+    {
+        return(nullptr);
+    }
+    if(gcomp<NODAL_RIGID_OFFSET)
+    {
+        comp=gcomp;
+        return(&core);
+    }
+    if(gcomp<NODAL_STRESS_OFFSET)
+    {
+        comp=gcomp-NODAL_RIGID_OFFSET;
+        return(rigid.ok()?&rigid:nullptr);
+    }
+    comp=gcomp-NODAL_STRESS_OFFSET;
+    return(stress.ok()?&stress:nullptr);
+}
+
+void get_nodaldata_names(Vector<std::string> &names)
+{
+    //Names of the nodal fields, in output id order
+    names.clear();
+    names.push_back("mass");
+    names.push_back("vel_x");
+    names.push_back("vel_y");
+    names.push_back("vel_z");
+    names.push_back("force_x");
+    names.push_back("force_y");
+    names.push_back("force_z");
+    names.push_back("delta_velx");
+    names.push_back("delta_vely");
+    names.push_back("delta_velz");
+    names.push_back("mass_old");
+    names.push_back("VELX_RIGID_INDEX");
+    names.push_back("VELY_RIGID_INDEX");
+    names.push_back("VELZ_RIGID_INDEX");
+    names.push_back("MASS_RIGID_INDEX");
+    names.push_back("RIGID_BODY_ID");
+    names.push_back("NX");
+    names.push_back("NY");
+    names.push_back("NZ");
+    names.push_back("STRESS_INDEX");
+}
+
+void select_nodal_output_fields(const Vector<std::string> &requested,
+                                const NodalData &nodal,
+                                Vector<std::string> &fieldnames,
+                                Vector<int> &fieldcomps)
+{
+    Vector<std::string> stored_names;
+    get_nodaldata_names(stored_names);
+
+    fieldnames.clear();
+    fieldcomps.clear();
+
+    //No selection in the inputs file means all allocated fields are written
+    if(requested.size()==0)
+    {
+        for(int gcomp=0;gcomp<stored_names.size();gcomp++)
+        {
+            int comp;
+            if(nodal.field(gcomp,comp)!=nullptr)
+            {
+                fieldnames.push_back(stored_names[gcomp]);
+                fieldcomps.push_back(gcomp);
+            }
+        }
+        return;
+    }
+
+    for(int n=0;n<requested.size();n++)
+    {
+        int gcomp=-1000;
+        if(requested[n]=="vel_mag")
+        {
+            gcomp=NODAL_DERIVED_VELMAG;
+        }
+        else if(requested[n]=="force_mag")
+        {
+            gcomp=NODAL_DERIVED_FRCMAG;
+        }
+        else
+        {
+            for(int c=0;c<stored_names.size();c++)
+            {
+                if(requested[n]==stored_names[c])
+                {
+                    gcomp=c;
+                }
+            }
+        }
+
+        if(gcomp==-1000)
+        {
+            amrex::Print()<<"\nUnknown nodal output field: "<<requested[n];
+            amrex::Abort("\nPlease check mpm.nodal_output_fields in the input file");
+        }
+        int comp;
+        if(gcomp>=0 && nodal.field(gcomp,comp)==nullptr)
+        {
+            amrex::Print()<<"\nNodal field "<<requested[n]<<" is not allocated in this run";
+            amrex::Abort("\nRigid-body fields need rigid particles, STRESS_INDEX needs test_number 7 or 8");
+        }
+        fieldnames.push_back(requested[n]);
+        fieldcomps.push_back(gcomp);
+    }
+}
+
+void fill_nodal_output_fields(const NodalData &nodal, MultiFab &outdata,
+                              const Vector<int> &fieldcomps)
+{
+    for(int n=0;n<fieldcomps.size();n++)
+    {
+        int gcomp=fieldcomps[n];
+        int comp;
+        const MultiFab* src=nodal.field(gcomp,comp);
+
+        for (MFIter mfi(outdata); mfi.isValid(); ++mfi)
+        {
+            //already nodal as mfi is from a nodal multifab
+            const Box& nodalbox=mfi.validbox();
+
+            Array4<Real const> nodal_data_arr=nodal.core.const_array(mfi);
+            Array4<Real const> src_arr=(src!=nullptr)?src->const_array(mfi):nodal_data_arr;
+            Array4<Real> out_arr=outdata.array(mfi);
+
+            amrex::ParallelFor(nodalbox,[=]
+            AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+            {
+                if(gcomp>=0)
+                {
+                    out_arr(i,j,k,n)=src_arr(i,j,k,comp);
+                }
+                else if(gcomp==NODAL_DERIVED_VELMAG)
+                {
+                    out_arr(i,j,k,n)=std::sqrt(nodal_data_arr(i,j,k,VELX_INDEX)*nodal_data_arr(i,j,k,VELX_INDEX)
+                                              +nodal_data_arr(i,j,k,VELY_INDEX)*nodal_data_arr(i,j,k,VELY_INDEX)
+                                              +nodal_data_arr(i,j,k,VELZ_INDEX)*nodal_data_arr(i,j,k,VELZ_INDEX));
+                }
+                else if(gcomp==NODAL_DERIVED_FRCMAG)
+                {
+                    out_arr(i,j,k,n)=std::sqrt(nodal_data_arr(i,j,k,FRCX_INDEX)*nodal_data_arr(i,j,k,FRCX_INDEX)
+                                              +nodal_data_arr(i,j,k,FRCY_INDEX)*nodal_data_arr(i,j,k,FRCY_INDEX)
+                                              +nodal_data_arr(i,j,k,FRCZ_INDEX)*nodal_data_arr(i,j,k,FRCZ_INDEX));
+                }
+            });
+        }
+    }
+}
+
+void write_grid_file(std::string fname, const NodalData &nodal, Vector<std::string> fieldnames, 
+                           Vector<int> fieldcomps,
+                           Geometry geom, BoxArray ba, DistributionMapping dm,Real time,
+                           int coarsen_ratio)
+{
+  int ncomp=fieldcomps.size();
+
+  //gather only the selected (and derived) fields before averaging
+  MultiFab nodalplot(nodal.core.boxArray(),dm,ncomp,0);
+  fill_nodal_output_fields(nodal,nodalplot,fieldcomps);
+
+  MultiFab plotmf(ba,dm,ncomp,0);
+  average_node_to_cellcenter(plotmf, 0, nodalplot, 0, ncomp);
+
+  if(coarsen_ratio>1)
+  {
+      BoxArray crse_ba=ba;
+      crse_ba.coarsen(coarsen_ratio);
+      Geometry crse_geom(amrex::coarsen(geom.Domain(),coarsen_ratio),
+                         &geom.ProbDomain(),geom.Coord(),geom.isPeriodic().data());
+
+      MultiFab crse_plotmf(crse_ba,dm,ncomp,0);
+      average_down(plotmf,crse_plotmf,0,ncomp,coarsen_ratio);
+      WriteSingleLevelPlotfile(fname, crse_plotmf, fieldnames, crse_geom, time, 0);
+  }
+  else
+  {
+      WriteSingleLevelPlotfile(fname, plotmf, fieldnames, geom, time, 0);
+  }
+}
+
+std::string write_grid_file_vtk(std::string output_folder, std::string pltname, const NodalData &nodal,
+                                Vector<std::string> fieldnames, Vector<int> fieldcomps,
+                                Geometry geom, int coarsen_ratio)
+{
+    BL_PROFILE("write_grid_file_vtk");
+    int ncomp=fieldcomps.size();
+    const std::string piecedir=pltname+"_vtk/";
+    if(ParallelDescriptor::IOProcessor())
+    {
+        amrex::UtilCreateDirectory(output_folder+piecedir,0755);
+    }
+    ParallelDescriptor::Barrier();
+
+    //nodes map directly onto VTK image points, so no averaging is needed
+    const MultiFab& nodaldata=nodal.core;
+    MultiFab nodalplot(nodaldata.boxArray(),nodaldata.DistributionMap(),ncomp,0);
+    fill_nodal_output_fields(nodal,nodalplot,fieldcomps);
+
+    Box domain=geom.Domain();
+    auto dx=geom.CellSizeArray();
+    MultiFab* outmf=&nodalplot;
+    MultiFab crse_nodalplot;
+    if(coarsen_ratio>1)
+    {
+        //inject every coarsen_ratio-th node
+        BoxArray crse_ba=amrex::convert(nodaldata.boxArray(),IntVect::TheCellVector());
+        crse_ba.coarsen(coarsen_ratio);
+        crse_ba.surroundingNodes();
+        crse_nodalplot.define(crse_ba,nodaldata.DistributionMap(),ncomp,0);
+        for(MFIter mfi(crse_nodalplot); mfi.isValid(); ++mfi)
+        {
+            const Box& bx=mfi.validbox();
+            Array4<Real> crse_arr=crse_nodalplot.array(mfi);
+            Array4<Real const> fine_arr=nodalplot.const_array(mfi);
+            amrex::ParallelFor(bx,ncomp,[=]
+            AMREX_GPU_DEVICE (int i,int j,int k,int n) noexcept
+            {
+                crse_arr(i,j,k,n)=fine_arr(i*coarsen_ratio,j*coarsen_ratio,k*coarsen_ratio,n);
+            });
+        }
+        domain.coarsen(coarsen_ratio);
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            dx[d]*=coarsen_ratio;
+        }
+        outmf=&crse_nodalplot;
+    }
+
+    const auto plo=geom.ProbLoArray();
+    auto extent_string=[](const Box& bx)
+    {
+        std::string ext;
+        for(int d=0;d<AMREX_SPACEDIM;d++)
+        {
+            ext+=std::to_string(bx.smallEnd(d))+" "+std::to_string(bx.bigEnd(d))+((d==AMREX_SPACEDIM-1)?"":" ");
+        }
+        return(ext);
+    };
+    std::ostringstream image_attribs;
+    image_attribs.precision(17);
+    image_attribs<<"Origin=\""<<plo[XDIR]<<" "<<plo[YDIR]<<" "<<plo[ZDIR]
+                 <<"\" Spacing=\""<<dx[XDIR]<<" "<<dx[YDIR]<<" "<<dx[ZDIR]<<"\"";
+    const std::string wholeextent=extent_string(amrex::surroundingNodes(domain));
+    const std::string realtype=(sizeof(Real)==sizeof(double))?"Float64":"Float32";
+
+    //one piece per box, staged through pinned host memory
+    for(MFIter mfi(*outmf); mfi.isValid(); ++mfi)
+    {
+        const Box& bx=mfi.validbox();
+        FArrayBox hostfab(bx,ncomp,The_Pinned_Arena());
+        hostfab.copy<RunOn::Device>((*outmf)[mfi],bx,0,bx,0,ncomp);
+        Gpu::streamSynchronize();
+
+        mpm_vtk::AppendedData data;
+        std::string pointdata_xml;
+        for(int n=0;n<ncomp;n++)
+        {
+            pointdata_xml+=data.add_array(fieldnames[n],realtype,1,hostfab.dataPtr(n),bx.numPts()*sizeof(Real));
+        }
+
+        const std::string piecename=output_folder+piecedir+pltname+"_"+std::to_string(mfi.index())+".vti";
+        std::ofstream ofs(piecename,std::ofstream::trunc|std::ofstream::binary);
+        if(!ofs.good())
+        {
+            amrex::FileOpenFailed(piecename);
+        }
+        ofs<<mpm_vtk::file_header("ImageData");
+        ofs<<"<ImageData WholeExtent=\""<<wholeextent<<"\" "<<image_attribs.str()<<">\n";
+        ofs<<"<Piece Extent=\""<<extent_string(bx)<<"\">\n";
+        ofs<<"<PointData>\n"<<pointdata_xml<<"</PointData>\n";
+        ofs<<"</Piece>\n</ImageData>\n";
+        data.write(ofs);
+        ofs<<"</VTKFile>\n";
+    }
+
+    if(ParallelDescriptor::IOProcessor())
+    {
+        const BoxArray& outba=outmf->boxArray();
+        std::ofstream ofs(output_folder+pltname+".pvti",std::ofstream::trunc);
+        ofs<<mpm_vtk::file_header("PImageData");
+        ofs<<"<PImageData WholeExtent=\""<<wholeextent<<"\" GhostLevel=\"0\" "<<image_attribs.str()<<">\n";
+        ofs<<"<PPointData>\n";
+        for(int n=0;n<ncomp;n++)
+        {
+            ofs<<"<PDataArray type=\""<<realtype<<"\" Name=\""<<fieldnames[n]<<"\" NumberOfComponents=\"1\"/>\n";
+        }
+        ofs<<"</PPointData>\n";
+        for(int b=0;b<outba.size();b++)
+        {
+            ofs<<"<Piece Extent=\""<<extent_string(outba[b])<<"\" Source=\""
+               <<piecedir+pltname+"_"+std::to_string(b)+".vti"<<"\"/>\n";
+        }
+        ofs<<mpm_vtk::file_footer("PImageData");
+    }
+
+    return(pltname+".pvti");
+}
+
+IntVect nodal_gather_ghosts(const GpuArray<int,AMREX_SPACEDIM>& order_scheme_directional,int moved)
+{
+    IntVect ng(0);
+    for(int d=0;d<AMREX_SPACEDIM;d++)
+    {
+        ng[d]=((order_scheme_directional[d]==3)?1:0)+moved;
+    }
+    return(ng);
+}
+
+void fill_nodal_ghosts(MultiFab &nodaldata,const Geometry& geom,
+                       int scomp,int ncomp,const IntVect& nghost)
+{
+    BL_PROFILE("fill_nodal_ghosts");
+    AMREX_ALWAYS_ASSERT(nghost.allLE(nodaldata.nGrowVect()));
+    if(nghost.max()>0)
+    {
+        nodaldata.FillBoundary(scomp,ncomp,nghost,geom.periodicity());
+    }
 }
 
 void backup_current_velocity(MultiFab &nodaldata)
@@ -41,31 +377,32 @@ void backup_current_velocity(MultiFab &nodaldata)
 void nodal_levelset_bcs(MultiFab &nodaldata,const Geometry geom,
                         amrex::Real &dt,int lsetbc,amrex::Real lset_wall_mu)
 {
-  //need something more sophisticated
-  //but lets get it working!
-  //
+    BL_PROFILE("nodal_levelset_bcs");
     int lsref=mpm_ebtools::ls_refinement;
     const auto plo = geom.ProbLoArray();
-    const auto phi = geom.ProbHiArray();
     const auto dx = geom.CellSizeArray();
 
     for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
     {
-        const Box& bx=mfi.validbox();
-        Box nodalbox = convert(bx, {1, 1, 1});
+        //only the wall nodes of the narrow band are visited
+        if(!mpm_ebtools::near_eb(mfi))
+        {
+            continue;
+        }
+        const Gpu::DeviceVector<IntVect>& nodes=(*mpm_ebtools::band_nodes)[mfi];
+        const IntVect* nodeptr=nodes.dataPtr();
+        const int nnodes=nodes.size();
 
         Array4<Real> nodal_data_arr=nodaldata.array(mfi);
         Array4<Real> lsarr=mpm_ebtools::lsphi->array(mfi);
 
-        amrex::ParallelFor(nodalbox,[=]
-        AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+        amrex::ParallelFor(nnodes,[=]
+        AMREX_GPU_DEVICE (int n) noexcept
         {
-            IntVect nodeid(i,j,k);
-            IntVect refined_nodeid(i*lsref,j*lsref,k*lsref);
+            IntVect nodeid=nodeptr[n];
 
-           if(lsarr(refined_nodeid) < TINYVAL && 
-              nodal_data_arr(nodeid,MASS_INDEX) > zero)
-           {
+            if(nodal_data_arr(nodeid,MASS_INDEX) > zero)
+            {
                 Real relvel_in[AMREX_SPACEDIM];
                 Real relvel_out[AMREX_SPACEDIM];
                 for(int d=0;d<AMREX_SPACEDIM;d++)
@@ -73,16 +410,12 @@ void nodal_levelset_bcs(MultiFab &nodaldata,const Geometry geom,
                    relvel_in[d]=nodal_data_arr(nodeid,VELX_INDEX+d);
                    relvel_out[d]=relvel_in[d];
                 }
-                
-                amrex::Real eps=0.00001;
-                amrex::Real xp[AMREX_SPACEDIM]={plo[XDIR]+i*dx[XDIR],
-                plo[YDIR]+j*dx[YDIR],plo[ZDIR]+k*dx[ZDIR]};
 
-                //amrex::Real dist=get_levelset_value(lsarr,plo,dx,xp,lsref); 
-                //dist=amrex::Math::abs(dist);
+                amrex::Real xp[AMREX_SPACEDIM]={plo[XDIR]+nodeid[XDIR]*dx[XDIR],
+                plo[YDIR]+nodeid[YDIR]*dx[YDIR],plo[ZDIR]+nodeid[ZDIR]*dx[ZDIR]};
 
                 amrex::Real normaldir[AMREX_SPACEDIM]={1.0,0.0,0.0};
-                
+
                 get_levelset_grad(lsarr,plo,dx,xp,lsref,normaldir);
                 amrex::Real gradmag=std::sqrt(normaldir[XDIR]*normaldir[XDIR]
                                             + normaldir[YDIR]*normaldir[YDIR]
@@ -91,14 +424,14 @@ void nodal_levelset_bcs(MultiFab &nodaldata,const Geometry geom,
                 normaldir[XDIR]=normaldir[XDIR]/(gradmag+TINYVAL);
                 normaldir[YDIR]=normaldir[YDIR]/(gradmag+TINYVAL);
                 normaldir[ZDIR]=normaldir[ZDIR]/(gradmag+TINYVAL);
-                
+
                 int modify_pos=applybc(relvel_in,relvel_out,lset_wall_mu,
                         normaldir,lsetbc);
-                
+
                 nodal_data_arr(nodeid,VELX_INDEX+XDIR)=relvel_out[XDIR];
                 nodal_data_arr(nodeid,VELX_INDEX+YDIR)=relvel_out[YDIR];
                 nodal_data_arr(nodeid,VELX_INDEX+ZDIR)=relvel_out[ZDIR];
-           }
+            }
         });
     }
 }
@@ -159,11 +492,51 @@ void nodal_update(MultiFab &nodaldata,const amrex::Real& dt, const amrex::Real&
     }
 }
 
-void nodal_detect_contact(MultiFab &nodaldata,const Geometry geom,amrex::Real& contact_tolerance,amrex::GpuArray<amrex::GpuArray<amrex::Real,AMREX_SPACEDIM>,numrigidbodies> velocity)
+void nodal_update_quasistatic(MultiFab &nodaldata,const amrex::Real& dt, const amrex::Real& mass_tolerance,
+                              amrex::Real mass_scaling,amrex::Real damping)
 {
-	const auto plo = geom.ProbLoArray();
-	const auto phi = geom.ProbHiArray();
-	const auto dx = geom.CellSizeArray();
+    //Explicit update with scaled nodal mass and local non-viscous damping,
+    //the damping force opposes the nodal velocity with a fraction of |F|
+    for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    {
+        const Box& bx=mfi.validbox();
+        Box nodalbox = convert(bx, {1, 1, 1});
+
+        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+
+        amrex::ParallelFor(nodalbox,[=]
+        AMREX_GPU_DEVICE (int i,int j,int k) noexcept
+        {
+            if(nodal_data_arr(i,j,k,MASS_INDEX) >=mass_tolerance)
+            {
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    amrex::Real frc=nodal_data_arr(i,j,k,FRCX_INDEX+d);
+                    amrex::Real vel=nodal_data_arr(i,j,k,VELX_INDEX+d);
+                    amrex::Real sgn=(vel>zero)?one:((vel<zero)?-one:zero);
+                    frc-=damping*std::fabs(frc)*sgn;
+
+                    nodal_data_arr(i,j,k,VELX_INDEX+d) += 
+                    frc/(mass_scaling*nodal_data_arr(i,j,k,MASS_INDEX))*dt;
+                }
+            }
+            else
+            {
+                nodal_data_arr(i,j,k,VELX_INDEX) = 0.0;
+                nodal_data_arr(i,j,k,VELY_INDEX) = 0.0;
+                nodal_data_arr(i,j,k,VELZ_INDEX) = 0.0;
+            }
+        });
+    }
+}
+
+amrex::Real nodal_residual_force_norm(MultiFab &nodaldata,const amrex::Real& dt, const amrex::Real& mass_tolerance)
+{
+    //L2 norm of the net nodal force m*delta_v/dt after boundary conditions,
+    //nodes shared by two boxes are counted twice which is fine for a ratio
+    ReduceOps<ReduceOpSum> reduce_op;
+    ReduceData<Real> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
 
     for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
     {
@@ -172,38 +545,107 @@ void nodal_detect_contact(MultiFab &nodaldata,const Geometry geom,amrex::Real& c
 
         Array4<Real> nodal_data_arr=nodaldata.array(mfi);
 
+        reduce_op.eval(nodalbox, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i,int j,int k) -> ReduceTuple
+        {
+            amrex::Real res=zero;
+            if(nodal_data_arr(i,j,k,MASS_INDEX) >=mass_tolerance)
+            {
+                for(int d=0;d<AMREX_SPACEDIM;d++)
+                {
+                    amrex::Real f=nodal_data_arr(i,j,k,MASS_INDEX)*nodal_data_arr(i,j,k,DELTA_VELX_INDEX+d)/dt;
+                    res+=f*f;
+                }
+            }
+            return{res};
+        });
+    }
+
+    amrex::Real res2=amrex::get<0>(reduce_data.value());
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealSum(res2);
+#endif
+    return(std::sqrt(res2));
+}
+
+void nodal_detect_contact(MultiFab &nodaldata,const MultiFab &rigiddata,const Geometry geom,
+                          amrex::Real& contact_tolerance,int nbodies,
+                          const Gpu::DeviceVector<amrex::Real> &body_motion,
+                          const amrex::Real& dt,amrex::Vector<amrex::Real> &body_load)
+{
+    BL_PROFILE("nodal_detect_contact");
+
+    const auto plo = geom.ProbLoArray();
+    const auto dx = geom.CellSizeArray();
+    const IntVect domhi=geom.Domain().bigEnd();
+    const IntVect nonperiodic(AMREX_D_DECL(!geom.isPeriodic(XDIR),!geom.isPeriodic(YDIR),!geom.isPeriodic(ZDIR)));
+    const amrex::Real* motionptr=body_motion.dataPtr();
+
+    //per-body force and torque, all bodies in one pass over the nodes
+    const int nload=2*AMREX_SPACEDIM;
+    Gpu::DeviceVector<amrex::Real> load_d(nload*nbodies,zero);
+    amrex::Real* loadptr=load_d.dataPtr();
+
+    for (MFIter mfi(nodaldata); mfi.isValid(); ++mfi)
+    {
+        const Box& bx=mfi.validbox();
+        Box nodalbox = convert(bx, {1, 1, 1});
+        const IntVect bxhi=bx.bigEnd();
+
+        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real const> rigid_arr=rigiddata.const_array(mfi);
 
         amrex::ParallelFor(nodalbox,[=]
         AMREX_GPU_DEVICE (int i,int j,int k) noexcept
         {
-            if(nodal_data_arr(i,j,k,MASS_INDEX) >contact_tolerance and nodal_data_arr(i,j,k,MASS_RIGID_INDEX)>contact_tolerance and int(nodal_data_arr(i,j,k,RIGID_BODY_ID))!=-1)
+            int b=int(rigid_arr(i,j,k,RIGID_BODY_ID));
+            if(nodal_data_arr(i,j,k,MASS_INDEX) >contact_tolerance and rigid_arr(i,j,k,MASS_RIGID_INDEX)>contact_tolerance and b!=-1 and b<nbodies)
             {
+            	const amrex::Real* m=motionptr+RIGID_MOTION_COMPS*b;
+            	amrex::Real xn[AMREX_SPACEDIM]={plo[XDIR]+i*dx[XDIR],plo[YDIR]+j*dx[YDIR],plo[ZDIR]+k*dx[ZDIR]};
+            	amrex::Real vbody[AMREX_SPACEDIM];
+            	rigid_point_velocity(m,xn,vbody);
+
             	amrex::Real contact_alpha=0.0;
             	for(int d=0;d<AMREX_SPACEDIM;d++)
             	{
-            		contact_alpha+= (nodal_data_arr(i,j,k,VELX_INDEX+d)-velocity[int(nodal_data_arr(i,j,k,RIGID_BODY_ID))][d])*nodal_data_arr(i,j,k,NORMALX+d);
+            		contact_alpha+= (nodal_data_arr(i,j,k,VELX_INDEX+d)-vbody[d])*rigid_arr(i,j,k,NORMALX+d);
             	}
 
            		if(contact_alpha>=0)
            		{
-           			amrex::Real V_relative=0.0;
+           			amrex::Real frc[AMREX_SPACEDIM];
            			for(int d=0;d<AMREX_SPACEDIM;d++)
            			{
-           				V_relative+=(nodal_data_arr(i,j,k,VELX_INDEX+d)-velocity[int(nodal_data_arr(i,j,k,RIGID_BODY_ID))][d])*nodal_data_arr(i,j,k,NORMALX+d);
+           				amrex::Real dvel=contact_alpha*(rigid_arr(i,j,k,NORMALX+d));
+           				nodal_data_arr(i,j,k,VELX_INDEX+d)-= dvel;
+           				frc[d]=nodal_data_arr(i,j,k,MASS_INDEX)*dvel/dt;
            			}
-           			for(int d=0;d<AMREX_SPACEDIM;d++)
+           			if(nodal_owned(IntVect(i,j,k),bxhi,domhi,nonperiodic))
            			{
-           				nodal_data_arr(i,j,k,VELX_INDEX+d)-= V_relative*(nodal_data_arr(i,j,k,NORMALX+d));
+           				amrex::Real r[AMREX_SPACEDIM];
+           				for(int d=0;d<AMREX_SPACEDIM;d++)
+           				{
+           					r[d]=xn[d]-m[RIGID_MOTION_CENTER+d];
+           				}
+           				amrex::Real* bload=loadptr+nload*b;
+           				Gpu::Atomic::AddNoRet(&bload[XDIR],frc[XDIR]);
+           				Gpu::Atomic::AddNoRet(&bload[YDIR],frc[YDIR]);
+           				Gpu::Atomic::AddNoRet(&bload[ZDIR],frc[ZDIR]);
+           				Gpu::Atomic::AddNoRet(&bload[AMREX_SPACEDIM+XDIR],r[YDIR]*frc[ZDIR]-r[ZDIR]*frc[YDIR]);
+           				Gpu::Atomic::AddNoRet(&bload[AMREX_SPACEDIM+YDIR],r[ZDIR]*frc[XDIR]-r[XDIR]*frc[ZDIR]);
+           				Gpu::Atomic::AddNoRet(&bload[AMREX_SPACEDIM+ZDIR],r[XDIR]*frc[YDIR]-r[YDIR]*frc[XDIR]);
            			}
            		}
-           		else
-           		{
-           			//nodal_data_arr(i,j,k,VELX_INDEX+1)=0.0;
-
-           		}
             }
         });
     }
+
+    body_load.resize(nload*nbodies);
+    Gpu::copy(Gpu::deviceToHost,load_d.begin(),load_d.end(),body_load.begin());
+#ifdef BL_USE_MPI
+    ParallelDescriptor::ReduceRealSum(body_load.dataPtr(),body_load.size());
+#endif
 }
 
 void initialise_shape_function_indices(iMultiFab &shapefunctionindex,const amrex::Geometry geom)
@@ -474,7 +916,8 @@ void CalculateSurfaceIntegralOnBG(const amrex::Geometry geom, amrex::MultiFab &n
 #endif
 }
 
-void CalculateInterpolationError(const amrex::Geometry geom,amrex::MultiFab &nodaldata, int nodaldataindex)
+void CalculateInterpolationError(const amrex::Geometry geom,const amrex::MultiFab &nodaldata,
+                                 amrex::MultiFab &errdata, int errindex)
 {
     const int* domloarr = geom.Domain().loVect();
     const int* domhiarr = geom.Domain().hiVect();
@@ -486,11 +929,12 @@ void CalculateInterpolationError(const amrex::Geometry geom,amrex::MultiFab &nod
         const Box& bx=mfi.validbox();
         Box nodalbox = convert(bx, {1, 1, 1});
 
-        Array4<Real> nodal_data_arr=nodaldata.array(mfi);
+        Array4<Real const> nodal_data_arr=nodaldata.const_array(mfi);
+        Array4<Real> err_arr=errdata.array(mfi);
 
         amrex::ParallelFor(nodalbox,[=]AMREX_GPU_DEVICE (int i,int j,int k) noexcept
                            {
-                               nodal_data_arr(i,j,k,nodaldataindex) = nodal_data_arr(i,j,k,VELX_INDEX)-cos(2.0*Pi*(domloarr[0]+i*dx[0])/1.0);
+                               err_arr(i,j,k,errindex) = nodal_data_arr(i,j,k,VELX_INDEX)-cos(2.0*Pi*(domloarr[0]+i*dx[0])/1.0);
                            });
     }
 
@@ -191,19 +191,19 @@ if(os.path.exists('./PostProc/')):
   if(os.path.exists('./PostProc/'+argv[13])):
     os.system('mv '+argv[9]+' '+'./PostProc/'+argv[13]+'/'+argv[9])
     os.system('mv '+argv[10]+' '+'./PostProc/'+argv[13]+'/'+argv[10])
-    os.system('mv AxialBarEnergy.out.0 '+'./PostProc/'+argv[13]+'/'+argv[11])
-    os.system('mv AxialBarVel.out.0 '+'./PostProc/'+argv[13]+'/'+argv[12])
+    os.system('mv AxialBarEnergy.out '+'./PostProc/'+argv[13]+'/'+argv[11])
+    os.system('mv AxialBarVel.out '+'./PostProc/'+argv[13]+'/'+argv[12])
   else:
     os.system('mkdir ./PostProc/'+argv[13])    
     os.system('mv '+argv[9]+' '+'./PostProc/'+argv[13]+'/'+argv[9])
     os.system('mv '+argv[10]+' '+'./PostProc/'+argv[13]+'/'+argv[10])
-    os.system('mv AxialBarEnergy.out.0 '+'./PostProc/'+argv[13]+'/'+argv[11])
-    os.system('mv AxialBarVel.out.0 '+'./PostProc/'+argv[13]+'/'+argv[12])
+    os.system('mv AxialBarEnergy.out '+'./PostProc/'+argv[13]+'/'+argv[11])
+    os.system('mv AxialBarVel.out '+'./PostProc/'+argv[13]+'/'+argv[12])
 else:
   os.system('mkdir ./PostProc')
   os.system('mkdir ./PostProc/'+argv[13])
   os.system('mv '+argv[9]+' '+'./PostProc/'+argv[13]+'/'+argv[9])
   os.system('mv '+argv[10]+' '+'./PostProc/'+argv[13]+'/'+argv[10])
-  os.system('mv AxialBarEnergy.out.0 '+'./PostProc/'+argv[13]+'/'+argv[11])
-  os.system('mv AxialBarVel.out.0 '+'./PostProc/'+argv[13]+'/'+argv[12])
+  os.system('mv AxialBarEnergy.out '+'./PostProc/'+argv[13]+'/'+argv[11])
+  os.system('mv AxialBarVel.out '+'./PostProc/'+argv[13]+'/'+argv[12])
 
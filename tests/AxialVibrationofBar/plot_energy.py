@@ -2,7 +2,7 @@ import numpy as np
 import matplotlib.pyplot as plt
 from sys import argv
 
-data=np.loadtxt('AxialBarEnergy.out.0')
+data=np.loadtxt('AxialBarEnergy.out')
 fig = plt.figure(1)
 ax = fig.add_subplot(111)
 ax.grid('on')
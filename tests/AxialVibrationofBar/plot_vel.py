@@ -2,7 +2,7 @@ import numpy as np
 import matplotlib.pyplot as plt
 from sys import argv
 
-data=np.loadtxt('AxialBarVel.out.0')
+data=np.loadtxt('AxialBarVel.out')
 
 
 
@@ -2,7 +2,7 @@ import numpy as np
 import matplotlib.pyplot as plt
 from sys import argv
 
-data=np.loadtxt('DamBreakWaterfront.out.0')
+data=np.loadtxt('DamBreakWaterfront.out')
 exp=np.loadtxt('ExperimentalData.dat')
 
 fig = plt.figure(1)
@@ -1 +1 @@
-rm -rf plt* nplt* dplt* ebplt* Backtrace* *.out.0 particle_files grid_files checkpoint_files
+rm -rf plt* nplt* dplt* ebplt* Backtrace* *.out *.out.0 probe_files particle_files grid_files checkpoint_files
@@ -0,0 +1,55 @@
+#include <AMReX.H>
+#include <AMReX_ParmParse.H>
+#include <mpm_specs.H>
+#include <mpm_eb.H>
+
+using namespace amrex;
+
+//Precomputes the signed-distance cache for an MPM inputs file, so that the
+//simulation and its restarts read the level set instead of rebuilding the EB.
+//Usage: levelset_cache.ex inputs eb2.levelset_cache=<dir>
+int main (int argc, char* argv[])
+{
+    amrex::Initialize(argc,argv);
+    {
+        MPMspecs specs;
+        specs.read_mpm_specs();
+
+        std::string cache_dir="";
+        ParmParse pp("eb2");
+        pp.query("levelset_cache",cache_dir);
+        if(cache_dir.empty())
+        {
+            amrex::Abort("\nPlease set eb2.levelset_cache to the cache directory");
+        }
+
+        //same background grid as the simulation
+        RealBox real_box;
+        for (int n = 0; n < AMREX_SPACEDIM; n++)
+        {
+            real_box.setLo(n, specs.plo[n]);
+            real_box.setHi(n, specs.phi[n]);
+        }
+        IntVect domain_lo(AMREX_D_DECL(0,0,0));
+        IntVect domain_hi(AMREX_D_DECL(specs.ncells[XDIR]-1,
+                                       specs.ncells[YDIR]-1,
+                                       specs.ncells[ZDIR]-1));
+        const Box domain(domain_lo, domain_hi);
+        int coord = 0;
+        Geometry geom(domain, &real_box, coord, specs.periodic.data());
+
+        BoxArray ba(domain);
+        ba.maxSize(specs.max_grid_size);
+        DistributionMapping dm(ba);
+
+        //same narrow band as the simulation
+        mpm_ebtools::init_eb(geom,ba,dm,specs.redistribution_drift_cells(),(specs.order_scheme==3)?2:1);
+        if(!mpm_ebtools::using_levelset_geometry)
+        {
+            amrex::Print()<<"\nNo level-set geometry in the inputs (eb2.geom_type), nothing to cache\n";
+        }
+        amrex::Print()<<"\n";
+    }
+    amrex::Finalize();
+    return 0;
+}